@@ -0,0 +1,193 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Node-API addon which parses a source buffer in place, recording all tokens and stacks into an
+// Int32Array for "src/harness/replay.js", rather than calling into JS per token.
+
+#include <node_api.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../core/parser.h"
+#include "../lib/gumnut.h"
+
+#ifndef BLEP_SINGLE_THREAD
+#error "the addon should be built with -DBLEP_SINGLE_THREAD"
+#endif
+
+// must match "src/harness/replay.js"
+#define EVENT_WORDS  6
+#define EVENT_OPEN   -1
+#define EVENT_CLOSE  -2
+
+// Node's worker threads have 4MB stacks, of which V8 may use about 1MB, so the parser gets 3MB. The
+// build's PARSER_MAX_DEPTH must fit in that (see PARSER_STACK_SIZE).
+#define STACK_BUDGET  (3 * 1024 * 1024)
+#if PARSER_MAX_DEPTH * 512 > STACK_BUDGET  // as PARSER_STACK_SIZE, which has a cast
+#error "PARSER_MAX_DEPTH is too deep for Node's worker threads"
+#endif
+
+// Lets generated files nest brackets past STACK_SIZE. Each level also recurses in the parser, so
+// this allows as many as it does.
+#define ARENA_DEPTH  PARSER_MAX_DEPTH
+static int arena[ARENA_DEPTH];
+
+// Events are written directly into the caller's array, moving to the heap if they don't fit.
+typedef struct {
+  int32_t *buf;
+  int count;
+  int cap;
+  int owned;  // whether buf is on the heap
+  char *base;
+} events;
+
+// The parser is built without thread-local state, so worker threads take turns.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int32_t *next_event(events *e) {
+  if (e->count == e->cap) {
+    e->cap = e->cap ? e->cap * 2 : 4096;
+    size_t bytes = sizeof(int32_t) * EVENT_WORDS * e->cap;
+    if (e->owned) {
+      e->buf = realloc(e->buf, bytes);
+    } else {
+      int32_t *prev = e->buf;
+      e->buf = malloc(bytes);
+      memcpy(e->buf, prev, sizeof(int32_t) * EVENT_WORDS * e->count);
+      e->owned = 1;
+    }
+  }
+  return e->buf + EVENT_WORDS * e->count++;
+}
+
+static void record_callback(void *user, struct token *t) {
+  events *e = user;
+  int32_t *out = next_event(e);
+  out[0] = t->vp - e->base;
+  out[1] = t->p - e->base;
+  out[2] = t->len;
+  out[3] = t->line_no;
+  out[4] = t->type;
+  out[5] = t->special;
+}
+
+static int record_open(void *user, int type) {
+  int32_t *out = next_event(user);
+  memset(out, 0, sizeof(int32_t) * EVENT_WORDS);
+  out[0] = EVENT_OPEN;
+  out[1] = type;
+  return 0;  // always record, the replay decides what to skip
+}
+
+static void record_close(void *user, int type) {
+  int32_t *out = next_event(user);
+  memset(out, 0, sizeof(int32_t) * EVENT_WORDS);
+  out[0] = EVENT_CLOSE;
+  out[1] = type;
+}
+
+#define _napi(call) if ((call) != napi_ok) { \
+  napi_throw_error(env, NULL, "gumnut: " #call " failed"); \
+  return NULL; \
+}
+
+static napi_value set_int(napi_env env, napi_value object, const char *name, int value) {
+  napi_value v;
+  _napi(napi_create_int32(env, value, &v));
+  _napi(napi_set_named_property(env, object, name, v));
+  return v;
+}
+
+// run(source: Uint8Array, start: number, end: number, scan: boolean, events: Int32Array)
+static napi_value run(napi_env env, napi_callback_info info) {
+  size_t argc = 5;
+  napi_value argv[5];
+  _napi(napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+
+  napi_typedarray_type type, events_type;
+  size_t length, events_length;
+  void *data, *events_data;
+  int32_t start, end;
+  bool scan;
+  if (argc < 5 ||
+      napi_get_typedarray_info(env, argv[0], &type, &length, &data, NULL, NULL) != napi_ok ||
+      type != napi_uint8_array ||
+      napi_get_value_int32(env, argv[1], &start) != napi_ok ||
+      napi_get_value_int32(env, argv[2], &end) != napi_ok ||
+      napi_get_value_bool(env, argv[3], &scan) != napi_ok ||
+      napi_get_typedarray_info(env, argv[4], &events_type, &events_length, &events_data, NULL, NULL) != napi_ok ||
+      events_type != napi_int32_array) {
+    napi_throw_type_error(env, NULL, "expected (Uint8Array, number, number, boolean, Int32Array)");
+    return NULL;
+  }
+  if (start < 0 || start > end || (size_t) end > length) {
+    napi_throw_range_error(env, NULL, "invalid range");
+    return NULL;
+  }
+
+  pthread_mutex_lock(&lock);
+
+  // nb. the parser never reads past end, so this parses the caller's memory in place
+  events e = {events_data, 0, events_length / EVENT_WORDS, 0, data};
+  gumnut_handlers h = {record_callback, record_open, record_close, &e};
+  char *p = (char *) data + start;
+  int ret = scan ? gumnut_scan(p, end - start, &h) : gumnut_run(p, end - start, &h);
+  if (ret == 0) {
+    ret = gumnut_steps();  // as the WASM harness returns
+  }
+
+  struct token *cursor = gumnut_cursor();
+  int at = ret < 0 ? cursor->p - e.base : 0;
+  int line_no = ret < 0 ? cursor->line_no : 0;
+
+  pthread_mutex_unlock(&lock);
+
+  napi_value result;
+  _napi(napi_create_object(env, &result));
+
+  if (e.owned) {
+    // didn't fit, so return a larger array for next time
+    napi_value buffer, array;
+    size_t bytes = sizeof(int32_t) * EVENT_WORDS * e.cap;
+    void *out;
+    napi_status status = napi_create_arraybuffer(env, bytes, &out, &buffer);
+    if (status == napi_ok) {
+      memcpy(out, e.buf, sizeof(int32_t) * EVENT_WORDS * e.count);
+    }
+    free(e.buf);
+    _napi(status);
+    _napi(napi_create_typedarray(env, napi_int32_array, bytes / sizeof(int32_t), buffer, 0, &array));
+    _napi(napi_set_named_property(env, result, "events", array));
+  } else {
+    _napi(napi_set_named_property(env, result, "events", argv[4]));
+  }
+
+  int count = e.count;
+  set_int(env, result, "ret", ret);
+  set_int(env, result, "count", count);
+  set_int(env, result, "at", at);
+  set_int(env, result, "lineNo", line_no);
+  return result;
+}
+
+NAPI_MODULE_INIT() {
+  blep_token_arena(arena, ARENA_DEPTH);
+
+  napi_value fn;
+  _napi(napi_create_function(env, "run", NAPI_AUTO_LENGTH, run, NULL, &fn));
+  _napi(napi_set_named_property(env, exports, "run", fn));
+  return exports;
+}
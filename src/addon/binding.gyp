@@ -0,0 +1,18 @@
+{
+  "targets": [
+    {
+      "target_name": "gumnut",
+      "sources": [
+        "addon.c",
+        "../lib/gumnut.c",
+        "../core/token.c",
+        "../core/parser.c"
+      ],
+      "defines": ["BLEP_SINGLE_THREAD", "PARSER_MAX_DEPTH=6144"],
+      "cflags_c": ["-std=gnu99", "-O3"],
+      "xcode_settings": {
+        "OTHER_CFLAGS": ["-std=gnu99", "-O3"]
+      }
+    }
+  ]
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Measures native parser throughput over the passed files, reporting MB/s, tokens/s and the p50/p99
+// latency of parsing a single file.
+// Usage: bench [-r runs] [-e|-t|-c|-l chunk] <file...>
+//        bench [-r runs] -d depth
+//
+// By default, a callback counts every token. With -e, the parser runs without handlers, and with
+// -t, only the tokenizer runs (see blep_token_records). With -c, each file is first encoded as a
+// token stream (see "src/lib/stream.h"), and the stream replay is measured instead. With -l, files
+// are fed to the chunked lexer (see "src/lib/lexer.h") in chunks of the passed size. With -d,
+// generated sources which nest to the passed depth are parsed instead, reporting the C stack used
+// per level.
+
+#include "../lib/gumnut.h"
+#include "../lib/lexer.h"
+#include "../lib/stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static void count_callback(void *user, struct token *t) {
+  ++*(long *) user;
+}
+
+// maps the file read-only, as the parser doesn't need a NULL terminator
+static char *map_file(const char *path, int *len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  char *buf = NULL;
+  if (fstat(fd, &st) == 0) {
+    *len = st.st_size;
+    // nb. mmap fails for empty files, but any non-NULL pointer will do
+    buf = *len ? mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+    if (buf == MAP_FAILED) {
+      buf = NULL;
+    }
+  }
+  close(fd);
+  return buf;
+}
+
+// lowest stack address seen by a callback, which is called from the deepest parser frames
+static char *stack_low;
+
+static void stack_callback(void *user, struct token *t) {
+  char marker;
+  if (&marker < stack_low) {
+    stack_low = &marker;
+  }
+  ++*(long *) user;
+}
+
+static int bench_deep(int depth, int runs) {
+  const char *prefixes[] = {"if (x) ", "x => ", "a: ", "for (;;) ", "a ? b : ", NULL};
+
+  for (int i = 0; prefixes[i]; ++i) {
+    int prefix_len = strlen(prefixes[i]);
+    int len = prefix_len * depth + 2;
+    char *p = malloc(len);
+    for (int j = 0; j < depth; ++j) {
+      memcpy(p + prefix_len * j, prefixes[i], prefix_len);
+    }
+    memcpy(p + prefix_len * depth, "z;", 2);
+
+    long tokens = 0;
+    gumnut_handlers h = {stack_callback, NULL, NULL, &tokens};
+    char base;
+    stack_low = &base;
+    int ret = 0;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < runs && ret >= 0; ++r) {
+      ret = gumnut_run(p, len, &h);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    double mb = (double) len * runs / (1024 * 1024);
+
+    printf("\"%s\" depth=%d ret=%d stack=%ld (%.0f bytes/level) throughput=%.2fMB/s\n", prefixes[i],
+        depth, ret, (long) (&base - stack_low), (double) (&base - stack_low) / depth, mb / seconds);
+    free(p);
+  }
+  return 0;
+}
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return x < y ? -1 : x > y;
+}
+
+// runs only the tokenizer, in batches, returning the number of tokens or a negative ERROR__ value
+static int lex_records(char *p, int len) {
+  static struct token_record records[4096];
+  int ret = blep_token_init(p, len);
+  int count = 0;
+  while (ret >= 0) {
+    ret = blep_token_records(records, 4096);
+    if (ret < 4096) {
+      break;
+    }
+    count += ret;
+  }
+  return ret < 0 ? ret : count + ret;
+}
+
+static int lex_chunks(char *p, int len, int chunk, gumnut_handlers *h) {
+  gumnut_lexer lx;
+  gumnut_lexer_init(&lx);
+  int ret = 0;
+  for (int at = 0; at < len && ret >= 0; at += chunk) {
+    ret = gumnut_lexer_feed(&lx, p + at, at + chunk > len ? len - at : chunk, h);
+  }
+  if (ret >= 0) {
+    ret = gumnut_lexer_end(&lx, h);
+  }
+  gumnut_lexer_free(&lx);
+  return ret;
+}
+
+int main(int argc, char **argv) {
+  int runs = 10;
+  int cached = 0;
+  int chunk = 0;
+  int depth = 0;
+  int empty = 0;
+  int tokenize = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:etcl:d:")) != -1) {
+    if (opt == 'r') {
+      runs = atoi(optarg);
+    } else if (opt == 'e') {
+      empty = 1;
+    } else if (opt == 't') {
+      tokenize = 1;
+    } else if (opt == 'c') {
+      cached = 1;
+    } else if (opt == 'l') {
+      chunk = atoi(optarg);
+    } else if (opt == 'd') {
+      depth = atoi(optarg);
+    } else {
+      return 1;
+    }
+  }
+  if (depth > 0) {
+    return bench_deep(depth, runs);
+  }
+
+  int count = argc - optind;
+  if (count <= 0) {
+    fprintf(stderr, "usage: %s [-r runs] [-e|-t|-c|-l chunk] <file...> | -d depth\n", argv[0]);
+    return 1;
+  }
+
+  char **bufs = malloc(sizeof(char *) * count);
+  int *lens = malloc(sizeof(int) * count);
+  long bytes = 0;
+  for (int i = 0; i < count; ++i) {
+    bufs[i] = map_file(argv[optind + i], &lens[i]);
+    if (!bufs[i]) {
+      fprintf(stderr, "could not read: %s\n", argv[optind + i]);
+      return 1;
+    }
+    bytes += lens[i];
+  }
+
+  gumnut_stream *streams = NULL;
+  long stream_bytes = 0;
+  if (cached) {
+    streams = malloc(sizeof(gumnut_stream) * count);
+    for (int i = 0; i < count; ++i) {
+      uint8_t *data;
+      size_t data_len;
+      gumnut_stream_encode(bufs[i], lens[i], 0, &data, &data_len);
+      gumnut_stream_load(&streams[i], data, data_len);
+      stream_bytes += data_len;
+    }
+  }
+
+  // count tokens up front, so that -e and -t are timed without a callback
+  long tokens = 0;
+  gumnut_handlers h = {count_callback, NULL, NULL, &tokens};
+  for (int i = 0; i < count; ++i) {
+    int ret;
+    if (tokenize) {
+      ret = lex_records(bufs[i], lens[i]);
+      tokens += ret > 0 ? ret : 0;
+    } else if (chunk > 0) {
+      ret = lex_chunks(bufs[i], lens[i], chunk, &h);
+    } else {
+      ret = gumnut_run(bufs[i], lens[i], &h);
+    }
+    if (ret < 0) {
+      fprintf(stderr, "failed to parse: %s\n", argv[optind + i]);
+    }
+  }
+  long timed_tokens = 0;
+  gumnut_handlers timed_h = {count_callback, NULL, NULL, &timed_tokens};
+  gumnut_handlers *timed = empty ? NULL : &timed_h;
+
+  double *latency = malloc(sizeof(double) * count * runs);
+  double start = now();
+
+  for (int r = 0; r < runs; ++r) {
+    for (int i = 0; i < count; ++i) {
+      double file_start = now();
+      if (tokenize) {
+        lex_records(bufs[i], lens[i]);
+      } else if (chunk > 0) {
+        lex_chunks(bufs[i], lens[i], chunk, timed);
+      } else if (cached) {
+        gumnut_stream_replay(&streams[i], bufs[i], timed);
+      } else {
+        gumnut_run(bufs[i], lens[i], timed);
+      }
+      latency[r * count + i] = now() - file_start;
+    }
+  }
+
+  double seconds = now() - start;
+  double mb = (double) bytes * runs / (1024 * 1024);
+  qsort(latency, count * runs, sizeof(double), compare_doubles);
+  double p50 = latency[(count * runs) / 2];
+  double p99 = latency[(count * runs) * 99 / 100];
+
+  printf("files=%d bytes=%ld tokens=%ld\n", count, bytes, tokens);
+  if (cached) {
+    printf("stream_bytes=%ld\n", stream_bytes);
+  }
+  printf("runs=%d time=%.3fs throughput=%.2fMB/s tokens/s=%.0f p50=%.1fus p99=%.1fus\n", runs, seconds,
+      mb / seconds, (double) tokens * runs / seconds, p50 * 1e6, p99 * 1e6);
+  free(latency);
+  return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Measures the JS harness over passed files or directories, in each of:
+ *
+ *   tokenize  the lexer runner's `tokens()`, which is always WASM
+ *   parse     `run()` with empty handlers
+ *   scan      `scan()` with empty handlers
+ *   rewrite   the imports rewriter, which also reads each file and writes nothing changed
+ *
+ * This uses the native addon if it has been built, unless `--wasm` is passed or `GUMNUT_WASM` is
+ * set. Tokens are counted once by the lexer, so tokens/s is comparable between modes.
+ *
+ * Usage: node src/bench/bench.js [--runs=N] [--wasm] [--mode=name] <file|dir...>
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+
+const args = process.argv.slice(2);
+let runs = 10;
+/** @type {string?} */
+let only = null;
+const paths = args.filter((arg) => {
+  let m = /^--runs=(\d+)$/.exec(arg);
+  if (m) {
+    runs = +m[1];
+    return false;
+  }
+  m = /^--mode=(\w+)$/.exec(arg);
+  if (m) {
+    only = m[1];
+    return false;
+  }
+  if (arg === '--wasm') {
+    process.env['GUMNUT_WASM'] = '1';
+    return false;
+  }
+  return true;
+});
+if (!paths.length) {
+  console.error('usage: bench.js [--runs=N] [--wasm] [--mode=name] <file|dir...>');
+  process.exit(1);
+}
+
+// imported after flags, as the harness checks GUMNUT_WASM when built
+const {default: buildHarness} = await import('../harness/node-harness.js');
+const {default: buildLexer, RECORD_WORDS} = await import('../harness/node-lexer.js');
+const {loadAddon} = await import('../harness/addon-harness.js');
+const {default: buildModuleImportRewriter} = await import('../tool/imports/lib.js');
+
+/** @type {string[]} */
+const files = [];
+for (const p of paths) {
+  if (fs.statSync(p).isDirectory()) {
+    const names = fs.readdirSync(p).filter((name) => name.endsWith('.js')).sort();
+    files.push(...names.map((name) => path.join(p, name)));
+  } else {
+    files.push(p);
+  }
+}
+const sources = files.map((f) => fs.readFileSync(f));
+const bytes = sources.reduce((total, s) => total + s.length, 0);
+
+const harness = await buildHarness();
+const lexer = await buildLexer();
+const rewrite = await buildModuleImportRewriter(() => () => undefined);
+
+let tokens = 0;
+for (const s of sources) {
+  lexer.prepare(s.length).set(s);
+  tokens += lexer.tokens().length / RECORD_WORDS;
+}
+
+/**
+ * Each mode returns a function which runs over one file.
+ *
+ * @type {{[mode: string]: () => (index: number) => void}}
+ */
+const modes = {
+  tokenize: () => (index) => {
+    const s = sources[index];
+    lexer.prepare(s.length).set(s);
+    lexer.tokens();
+  },
+  parse: () => {
+    harness.handle({});
+    return (index) => {
+      const s = sources[index];
+      harness.prepare(s.length).set(s);
+      harness.run();
+    };
+  },
+  scan: () => {
+    harness.handle({});
+    return (index) => {
+      const s = sources[index];
+      harness.prepare(s.length).set(s);
+      harness.scan();
+    };
+  },
+  rewrite: () => {
+    const write = (/** @type {Uint8Array} */ part) => {};
+    return (index) => rewrite(files[index], write);
+  },
+};
+if (only !== null && !(only in modes)) {
+  console.error(`unknown mode: ${only}`);
+  process.exit(1);
+}
+
+const backend = loadAddon() ? 'native' : 'wasm';
+console.info(`files=${files.length} bytes=${bytes} tokens=${tokens} backend=${backend}`);
+
+for (const [mode, build] of Object.entries(modes)) {
+  if (only !== null && mode !== only) {
+    continue;
+  }
+  const step = build();
+
+  // warm up, and check every file parses
+  files.forEach((_, index) => step(index));
+
+  /** @type {number[]} */
+  const latencies = [];
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < runs; ++i) {
+    for (let index = 0; index < files.length; ++index) {
+      const fileStart = process.hrtime.bigint();
+      step(index);
+      latencies.push(Number(process.hrtime.bigint() - fileStart) / 1e3);
+    }
+  }
+  const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+  const mb = (bytes * runs) / (1024 * 1024);
+
+  latencies.sort((a, b) => a - b);
+  const percentile = (/** @type {number} */ p) => latencies[Math.floor(latencies.length * p)];
+
+  console.info(`mode=${mode} runs=${runs} time=${seconds.toFixed(3)}s ` +
+    `throughput=${(mb / seconds).toFixed(2)}MB/s tokens/s=${Math.round(tokens * runs / seconds)} ` +
+    `p50=${percentile(0.5).toFixed(1)}us p99=${percentile(0.99).toFixed(1)}us`);
+}
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Generates the benchmark corpus, so that nothing large is checked in. The output is
+ * the same for the same seed and scale.
+ *
+ *   source/        source-style modules, with comments, classes, templates and regexps
+ *   minified/      bundles of those modules, run through the light minifier
+ *   pathological/  files which stress one part of the tokenizer or parser each
+ *
+ * Usage: node src/bench/corpus.js [--out=_build/corpus] [--scale=N] [--seed=N]
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+import buildMinifier from '../tool/minify/lib.js';
+
+const options = {out: '_build/corpus', scale: 1, seed: 1};
+for (const arg of process.argv.slice(2)) {
+  const m = /^--(out|scale|seed)=(.+)$/.exec(arg);
+  if (!m) {
+    console.error('usage: corpus.js [--out=dir] [--scale=N] [--seed=N]');
+    process.exit(1);
+  }
+  const key = /** @type {'out'|'scale'|'seed'} */ (m[1]);
+  options[key] = /** @type {never} */ (key === 'out' ? m[2] : +m[2]);
+}
+
+/**
+ * Mulberry32, so the corpus is reproducible.
+ *
+ * @param {number} seed
+ * @return {() => number} in [0, 1)
+ */
+function buildRandom(seed) {
+  return () => {
+    seed = (seed + 0x6d2b79f5) | 0;
+    let t = Math.imul(seed ^ (seed >>> 15), 1 | seed);
+    t = (t + Math.imul(t ^ (t >>> 7), 61 | t)) ^ t;
+    return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+  };
+}
+
+const random = buildRandom(options.seed);
+const int = (/** @type {number} */ n) => Math.floor(random() * n);
+const pick = (/** @type {string[]} */ all) => all[int(all.length)];
+
+const words = ['item', 'value', 'node', 'entry', 'state', 'config', 'result', 'buffer', 'handler',
+  'request', 'target', 'index', 'count', 'source', 'options', 'context', 'cache', 'queue'];
+const name = () => pick(words) + (int(4) ? pick(words).replace(/^./, (c) => c.toUpperCase()) : '');
+
+/**
+ * @param {number} n
+ * @return {string} a source-style module
+ */
+function sourceModule(n) {
+  const parts = [`/**\n * Module ${n}, generated for benchmarks.\n */\n`];
+
+  for (let i = int(5); i >= 0; --i) {
+    parts.push(int(2) ?
+      `import {${name()}, ${name()} as ${name()}${i}} from './module-${int(200)}.js';\n` :
+      `import * as ${name()}${i} from 'package-${int(50)}';\n`);
+  }
+  parts.push('\n');
+
+  const units = [
+    (/** @type {string} */ id) => `export class ${id} extends Base {
+  #${name()} = ${int(100)};
+
+  constructor(options = {}) {
+    super();
+    this.options = {...options, id: '${id}'};
+  }
+
+  async load(url) {
+    const response = await fetch(\`\${url}/${name()}/\${this.options.id}?n=\${${int(10)} * 2}\`);
+    return response.ok ? response.json() : null;
+  }
+
+  get size() {
+    return this.items?.length ?? 0;
+  }
+}
+`,
+    (/** @type {string} */ id) => `// Sums every ${name()} over the passed limit.
+export function ${id}(values, limit) {
+  let total = 0;
+  for (let i = 0; i < values.length; ++i) {
+    if (values[i] > limit) {
+      total += values[i] / limit * ${int(10) + 1};
+    }
+  }
+  return values.filter((v) => v !== limit).map((v) => ({v, half: v / 2, total}));
+}
+`,
+    (/** @type {string} */ id) => `const ${id}Pattern = /^(${name()}|${name()})[-_]?\\d+$/i;
+
+export const ${id} = (input) => {
+  const match = ${id}Pattern.exec(input);
+  /* nb. returns null rather than throwing */
+  return match ? match[1].split(/[-_]/).join('.') : null;
+};
+`,
+    (/** @type {string} */ id) => `export default async function* ${id}(source) {
+  try {
+    for await (const chunk of source) {
+      yield* chunk.split('\\n').map((line, i) => \`\${i}: \${line}\`);
+    }
+  } catch (e) {
+    console.warn('failed to read ${id}', e);
+  } finally {
+    source.close?.();
+  }
+}
+`,
+    (/** @type {string} */ id) => `export const ${id} = {
+  ${name()}: ${int(1000)},
+  '${name()}-key': [${int(9)}, ${int(9)}, ${int(9)}],
+  async ${name()}() { return await Promise.all([this.${name()}, 1].map(async (x) => x)); },
+  get ${name()}() { return typeof ${name()} === 'undefined' ? void 0 : ${int(99)}n; },
+};
+`,
+  ];
+
+  for (let i = 8 + int(24); i >= 0; --i) {
+    parts.push(pick(/** @type {any} */ (units))(name() + n + '_' + i), '\n');
+  }
+  return parts.join('');
+}
+
+/**
+ * @param {string} s
+ * @param {number} bytes
+ * @return {string} s repeated to about the passed size
+ */
+const repeat = (s, bytes) => s.repeat(Math.max(1, Math.round(bytes / s.length)));
+
+const scale = options.scale;
+const size = 256 * 1024 * scale;
+
+/** @type {{[file: string]: string}} */
+const pathological = {
+  'deep-brackets.js': repeat(`x = ${'['.repeat(200)}0${']'.repeat(200)};\n`, size),
+  'deep-blocks.js': repeat(`if (a) ${'{ if (b) '.repeat(100)}c;${' }'.repeat(100)}\n`, size),
+  'arrow-chain.js': repeat(`f = ${'a => '.repeat(200)}a;\n`, size),
+  'long-string.js': `export default '${repeat('abc\\\'def ', size)}';\n`,
+  'long-line.js': `export default ${repeat('a + b * c - d / e % ', size)}f;\n`,
+  'regexp-division.js': repeat(`x = a / b / c; y = /re[/]x/g.test(s) / 2; z = (a) / /b/.source;\n`, size),
+  'templates.js': repeat('s = `a${`b${`c${d}`}`}e${f ? `g` : `h${i}`}`;\n', size),
+  'data-module.js': `export default [\n${repeat(`  {"id": 123, "name": "entry", "tags": ["a", "b"], "ok": true},\n`, size)}];\n`,
+  'comments.js': repeat(`/* block comment ${'*'.repeat(40)} */\n// line comment\nx;\n`, size),
+  'asi.js': repeat(`a = b\n(c || d).e()\nx\n++y\n[1, 2].map(f)\nlet\nz\n`, size),
+};
+
+/**
+ * @param {string} dir
+ * @param {string} file
+ * @param {string} content
+ */
+function write(dir, file, content) {
+  const target = path.join(options.out, dir, file);
+  fs.mkdirSync(path.dirname(target), {recursive: true});
+  fs.writeFileSync(target, content);
+}
+
+const sourceCount = 200 * scale;
+/** @type {string[]} */
+const sources = [];
+for (let i = 0; i < sourceCount; ++i) {
+  const s = sourceModule(i);
+  write('source', `module-${i}.js`, s);
+  sources.push(s);
+}
+
+const minify = await buildMinifier();
+const bundleCount = 4 * scale;
+fs.mkdirSync(path.join(options.out, 'minified'), {recursive: true});
+for (let i = 0; i < bundleCount; ++i) {
+  const from = Math.floor(i * sources.length / bundleCount);
+  const to = Math.floor((i + 1) * sources.length / bundleCount);
+  const unminified = path.join(options.out, 'minified', `.bundle-${i}.js`);
+  fs.writeFileSync(unminified, sources.slice(from, to).join('\n'));
+
+  /** @type {Uint8Array[]} */
+  const parts = [];
+  minify(unminified, (part) => parts.push(Uint8Array.from(part)));
+  fs.rmSync(unminified);
+  write('minified', `bundle-${i}.js`, Buffer.concat(parts).toString());
+}
+
+for (const [file, content] of Object.entries(pathological)) {
+  write('pathological', file, content);
+}
+
+let total = 0;
+for (const dir of ['source', 'minified', 'pathological']) {
+  const files = fs.readdirSync(path.join(options.out, dir));
+  const bytes = files.reduce((t, f) => t + fs.statSync(path.join(options.out, dir, f)).size, 0);
+  console.info(`${dir}: files=${files.length} bytes=${bytes}`);
+  total += bytes;
+}
+console.info(`wrote ${total} bytes to ${options.out}`);
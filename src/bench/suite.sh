@@ -0,0 +1,40 @@
+#!/bin/bash
+#
+# Runs every benchmark over a generated corpus: the native tokenizer, parser with and without
+# callbacks, then the JS harness with the native addon (if it builds) and WASM. Pass extra
+# arguments for "corpus.js" (e.g., "--scale=4"); the corpus is only generated once per directory.
+#
+# Usage: src/bench/suite.sh [--out=_build/corpus] [--scale=N] [--seed=N]
+
+cd "${BASH_SOURCE%/*}/../.." || exit
+
+set -eu
+
+CORPUS=_build/corpus
+for ARG in "$@"; do
+  case $ARG in
+    --out=*) CORPUS=${ARG#--out=} ;;
+  esac
+done
+RUNS=${RUNS:-10}
+
+if [ ! -d "$CORPUS" ]; then
+  node src/bench/corpus.js "$@"
+fi
+
+make -s _build/bench
+make -s addon 2>/dev/null || echo "(addon not built, JS results are WASM only)"
+
+for KIND in source minified pathological; do
+  echo "== $KIND"
+  echo "-- native parse"
+  _build/bench -r $RUNS "$CORPUS/$KIND"/*.js | tail -1
+  echo "-- native parse, no callbacks"
+  _build/bench -r $RUNS -e "$CORPUS/$KIND"/*.js | tail -1
+  echo "-- native tokenize"
+  _build/bench -r $RUNS -t "$CORPUS/$KIND"/*.js | tail -1
+  echo "-- js (native addon)"
+  node src/bench/bench.js --runs=$RUNS "$CORPUS/$KIND"
+  echo "-- js (wasm)"
+  node src/bench/bench.js --runs=$RUNS --wasm "$CORPUS/$KIND"
+done
@@ -4,11 +4,19 @@ set -eu
 
 # Build the broad set of types, but copy the only hand-written part into place.
 rm -rf generatedTypes
-tsc index.js --declaration --allowJs --emitDeclarationOnly --outDir generatedTypes
+tsc index.js src/harness/node-imports.js src/harness/node-lexer.js --declaration --allowJs --emitDeclarationOnly --outDir generatedTypes
 cp src/harness/types/index.d.ts generatedTypes/src/harness/types/
 
 # TypeScript 4.1.3 (and possibly later) doesn't support types for subpath imports.
-rm -rf imports/
-mkdir -p imports/
-echo "export * from '../src/tool/imports/lib';" > imports/index.d.ts
-echo "export {default} from '../src/tool/imports/lib';" >> imports/index.d.ts
+for tool in imports graph importmap unused minify coverage watch; do
+  rm -rf ${tool}/
+  mkdir -p ${tool}/
+  echo "export * from '../src/tool/${tool}/lib';" > ${tool}/index.d.ts
+  echo "export {default} from '../src/tool/${tool}/lib';" >> ${tool}/index.d.ts
+done
+
+rm -rf runner/
+mkdir -p runner/full/ runner/imports/ runner/lexer/
+echo "export {default} from '../../generatedTypes/src/harness/node-harness';" > runner/full/index.d.ts
+echo "export {default} from '../../generatedTypes/src/harness/node-imports';" > runner/imports/index.d.ts
+echo "export {default} from '../../generatedTypes/src/harness/node-lexer';" > runner/lexer/index.d.ts
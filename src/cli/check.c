@@ -0,0 +1,221 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Checks that files parse, printing "file:line: error" for each which doesn't and exiting non-zero
+// if any failed. This is built with BLEP_VALIDATE, so the parser emits nothing (see "parser.h").
+//
+// Usage: gumnut-check [-j threads] [-s] <file...>
+//   -j  number of threads (default: number of CPUs)
+//   -s  only check module statements, as gumnut_scan
+//
+// Pass "-" to check standard input.
+
+#include "../core/parser.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef BLEP_VALIDATE
+#error "gumnut-check should be built with -DBLEP_VALIDATE"
+#endif
+
+static char **files;
+static int files_count;
+static int next_file;  // shared among workers
+static int failed;
+static int scan_only;
+
+static pthread_mutex_t stdout_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *describe(int ret) {
+  switch (ret) {
+    case ERROR__STACK:
+      return "unbalanced or too deeply nested";
+    case ERROR__INTERNAL:
+      return "internal error";
+  }
+  return "unexpected token";
+}
+
+// parses p, returning zero or a negative ERROR__ value
+static int check(char *p, int len) {
+  int ret = blep_parser_init(p, len);
+  int (*step)() = scan_only ? blep_parser_scan : blep_parser_run;
+  while (ret >= 0) {
+    ret = step();
+    if (ret == 0) {
+      break;
+    }
+  }
+  return ret;
+}
+
+static void report(const char *path, int line_no, const char *message) {
+  pthread_mutex_lock(&stdout_lock);
+  printf("%s:%d: %s\n", path, line_no, message);
+  ++failed;
+  pthread_mutex_unlock(&stdout_lock);
+}
+
+// reads all of stdin, or returns NULL if it's too large to parse (or to fit in memory)
+static char *read_stdin(int *len) {
+  size_t cap = 64 * 1024;
+  size_t used = 0;
+  char *p = malloc(cap);
+  if (!p) {
+    return NULL;
+  }
+  size_t n;
+  while ((n = fread(p + used, 1, cap - used, stdin)) > 0) {
+    used += n;
+    if (used > INT_MAX) {
+      free(p);
+      return NULL;
+    }
+    if (used == cap) {
+      char *grown = realloc(p, cap * 2);
+      if (!grown) {
+        free(p);
+        return NULL;
+      }
+      p = grown;
+      cap *= 2;
+    }
+  }
+  *len = used;
+  return p;
+}
+
+static void check_file(const char *path) {
+  if (!strcmp(path, "-")) {
+    int len;
+    char *p = read_stdin(&len);
+    if (!p) {
+      report("-", 0, "too large");
+      return;
+    }
+    int ret = check(p, len);
+    if (ret < 0) {
+      report("-", blep_parser_cursor()->line_no, describe(ret));
+    }
+    free(p);
+    return;
+  }
+
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    report(path, 0, "could not read");
+    return;
+  }
+
+  // the parser works in int offsets, so larger files can't be parsed at all
+  if (st.st_size > INT_MAX) {
+    close(fd);
+    report(path, 0, "too large");
+    return;
+  }
+
+  // nb. the parser never reads past len, so a mapping need not be NULL-terminated
+  char *p = NULL;
+  if (st.st_size > 0) {
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (p == MAP_FAILED) {
+    report(path, 0, "could not read");
+    return;
+  }
+
+  int ret = check(p ? p : (char *) "", st.st_size);
+  if (ret < 0) {
+    report(path, blep_parser_cursor()->line_no, describe(ret));
+  }
+  if (p) {
+    munmap(p, st.st_size);
+  }
+}
+
+static void *work(void *arg) {
+  // brackets deeper than this would exceed the parser's own depth limit
+  int *arena = malloc(sizeof(int) * PARSER_MAX_DEPTH);
+  blep_token_arena(arena, PARSER_MAX_DEPTH);
+
+  int index;
+  while ((index = __atomic_fetch_add(&next_file, 1, __ATOMIC_RELAXED)) < files_count) {
+    check_file(files[index]);
+  }
+
+  blep_token_arena(NULL, 0);
+  free(arena);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while ((opt = getopt(argc, argv, "j:s")) != -1) {
+    switch (opt) {
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 's':
+        scan_only = 1;
+        break;
+      default:
+        return 1;
+    }
+  }
+
+  files = argv + optind;
+  files_count = argc - optind;
+  if (!files_count) {
+    fprintf(stderr, "usage: %s [-j threads] [-s] <file...>\n", argv[0]);
+    return 1;
+  }
+  if (threads > files_count) {
+    threads = files_count;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  // workers get a stack large enough for the deepest nesting the parser allows, which the main
+  // thread may not have
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, PARSER_STACK_SIZE);
+  pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+  for (int i = 0; i < threads; ++i) {
+    pthread_create(&workers[i], &attr, work, NULL);
+  }
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(workers[i], NULL);
+  }
+  pthread_attr_destroy(&attr);
+  free(workers);
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,641 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Parses files on a pool of threads, printing a line of NDJSON per file (tokens, imports and any
+// error) and a summary to stderr. Directories are searched for .js, .mjs and .cjs files.
+//
+// Byte-identical files (common with nested node_modules) are only parsed once: files are bucketed
+// by size, those sharing a size are hashed and compared, and each copy reports the result of the
+// first with a "duplicate" field naming it.
+//
+// Usage: gumnut [-j threads] [-s] [-q] [-D] <file|dir|glob...>
+//   -j  number of threads (default: number of CPUs)
+//   -s  scan only module statements, which is faster for finding imports
+//   -q  don't print per-file results
+//   -D  parse every file, even if it's a duplicate
+
+#include "../core/parser.h"
+#include "../lib/gumnut.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLUSH_AT (64 * 1024)
+
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t cap;
+} outbuf;
+
+// Each worker owns a deque of file indexes. It pops from the tail, and others steal from the head.
+typedef struct {
+  pthread_mutex_t lock;
+  int *items;
+  int head;
+  int tail;
+} deque;
+
+typedef struct {
+  int index;
+  pthread_t thread;
+  outbuf out;
+  long bytes;
+  long tokens;
+  int errors;
+} worker;
+
+typedef struct {
+  outbuf *out;
+  long tokens;
+  int imports;
+} file_state;
+
+// Per-file state, indexed the same as files. Duplicates point to the first file with the same
+// content, which records its result for them.
+typedef struct {
+  off_t size;
+  uint64_t hash;
+  int canonical;   // own index unless this is a duplicate
+  int duplicates;  // number of other files which point here
+  char *result;    // JSON after the file name, if duplicates
+  long tokens;
+  int failed;
+} file_info;
+
+static char **files;
+static file_info *infos;
+static int files_count;
+static int files_cap;
+
+// Directories already walked, as an open-addressed set of (device, inode). Symlinks are followed,
+// but cycles and links to the same directory (e.g., pnpm's node_modules) are only walked once.
+typedef struct {
+  dev_t dev;
+  ino_t ino;
+  int used;
+} dir_id;
+
+static dir_id *visited;
+static int visited_count;
+static int visited_cap;  // power of two
+
+static deque *deques;
+static worker *workers;
+static int workers_count;
+
+static int scan_only;
+static int quiet;
+static int no_dedupe;
+static pthread_mutex_t stdout_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void out_write(outbuf *o, const char *s, size_t n) {
+  if (o->len + n > o->cap) {
+    o->cap = (o->len + n) * 2;
+    o->buf = realloc(o->buf, o->cap);
+  }
+  memcpy(o->buf + o->len, s, n);
+  o->len += n;
+}
+
+static void out_printf(outbuf *o, const char *format, ...) {
+  char tmp[256];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(tmp, sizeof(tmp), format, args);
+  va_end(args);
+  out_write(o, tmp, n < (int) sizeof(tmp) ? n : (int) sizeof(tmp) - 1);
+}
+
+// writes s as a JSON string, escaping only what JSON requires
+static void out_json_string(outbuf *o, const char *s, int len) {
+  out_write(o, "\"", 1);
+  int from = 0;
+  for (int i = 0; i < len; ++i) {
+    unsigned char c = s[i];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    out_write(o, s + from, i - from);
+    from = i + 1;
+    if (c == '"' || c == '\\') {
+      char escape[2] = {'\\', c};
+      out_write(o, escape, 2);
+    } else {
+      out_printf(o, "\\u%04x", c);
+    }
+  }
+  out_write(o, s + from, len - from);
+  out_write(o, "\"", 1);
+}
+
+static void out_flush(outbuf *o) {
+  if (!o->len) {
+    return;
+  }
+  pthread_mutex_lock(&stdout_lock);
+  fwrite(o->buf, 1, o->len, stdout);
+  pthread_mutex_unlock(&stdout_lock);
+  o->len = 0;
+}
+
+static void add_file(const char *path, off_t size) {
+  if (files_count == files_cap) {
+    files_cap = files_cap ? files_cap * 2 : 256;
+    files = realloc(files, sizeof(char *) * files_cap);
+    infos = realloc(infos, sizeof(file_info) * files_cap);
+  }
+  infos[files_count] = (file_info) {.size = size, .canonical = files_count};
+  files[files_count++] = strdup(path);
+}
+
+static int is_js(const char *name) {
+  const char *ext = strrchr(name, '.');
+  return ext && (!strcmp(ext, ".js") || !strcmp(ext, ".mjs") || !strcmp(ext, ".cjs"));
+}
+
+static size_t dir_slot(dir_id *set, int cap, dev_t dev, ino_t ino) {
+  size_t i = ((uint64_t) ino * 0x9e3779b97f4a7c15ull ^ (uint64_t) dev) & (cap - 1);
+  while (set[i].used && (set[i].dev != dev || set[i].ino != ino)) {
+    i = (i + 1) & (cap - 1);
+  }
+  return i;
+}
+
+// records a directory as walked, returning zero if it already was
+static int visit_dir(const struct stat *st) {
+  if (visited_count * 2 >= visited_cap) {
+    int cap = visited_cap ? visited_cap * 2 : 256;
+    dir_id *set = calloc(cap, sizeof(dir_id));
+    for (int i = 0; i < visited_cap; ++i) {
+      if (visited[i].used) {
+        set[dir_slot(set, cap, visited[i].dev, visited[i].ino)] = visited[i];
+      }
+    }
+    free(visited);
+    visited = set;
+    visited_cap = cap;
+  }
+
+  dir_id *slot = &visited[dir_slot(visited, visited_cap, st->st_dev, st->st_ino)];
+  if (slot->used) {
+    return 0;
+  }
+  *slot = (dir_id) {st->st_dev, st->st_ino, 1};
+  ++visited_count;
+  return 1;
+}
+
+static void add_dir(const char *path, const struct stat *st) {
+  if (!visit_dir(st)) {
+    return;
+  }
+  DIR *dir = opendir(path);
+  if (!dir) {
+    fprintf(stderr, "could not read: %s\n", path);
+    return;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    if (entry->d_name[0] == '.') {
+      continue;  // includes "." and "..", as well as hidden files such as ".git"
+    }
+    size_t len = strlen(path) + strlen(entry->d_name) + 2;
+    char *child = malloc(len);
+    snprintf(child, len, "%s/%s", path, entry->d_name);
+
+    struct stat st;
+    if (stat(child, &st) == 0) {
+      if (S_ISDIR(st.st_mode)) {
+        add_dir(child, &st);
+      } else if (S_ISREG(st.st_mode) && is_js(entry->d_name)) {
+        add_file(child, st.st_size);
+      }
+    }
+    free(child);
+  }
+  closedir(dir);
+}
+
+// adds a path passed on the command-line, which is always included if it's a file
+static void add_path(const char *path) {
+  struct stat st;
+  if (stat(path, &st) == 0) {
+    if (S_ISDIR(st.st_mode)) {
+      add_dir(path, &st);
+    } else {
+      add_file(path, st.st_size);
+    }
+    return;
+  }
+
+  // not a real path, so try it as a glob (e.g., if passed quoted)
+  glob_t g;
+  if (glob(path, 0, NULL, &g) != 0) {
+    fprintf(stderr, "could not find: %s\n", path);
+    return;
+  }
+  for (size_t i = 0; i < g.gl_pathc; ++i) {
+    add_path(g.gl_pathv[i]);
+  }
+  globfree(&g);
+}
+
+// Fast non-cryptographic hash, reading eight bytes at a time. Matches are confirmed with memcmp.
+static uint64_t hash_bytes(const char *p, size_t len) {
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t v;
+    memcpy(&v, p + i, 8);
+    h = (h ^ v) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  uint64_t tail = 0;
+  memcpy(&tail, p + i, len - i);
+  h = (h ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+  return h ^ (h >> 29);
+}
+
+static char *map_path(const char *path, size_t len) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  char *p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return p == MAP_FAILED ? NULL : p;
+}
+
+// orders by size then hash, then index so the first file of a group is its canonical
+static int compare_files(const void *a, const void *b) {
+  const file_info *x = &infos[*(const int *) a];
+  const file_info *y = &infos[*(const int *) b];
+  if (x->size != y->size) {
+    return x->size < y->size ? -1 : 1;
+  }
+  if (x->hash != y->hash) {
+    return x->hash < y->hash ? -1 : 1;
+  }
+  return *(const int *) a - *(const int *) b;
+}
+
+// Finds duplicate files. Only files which share their size with another are read. Returns the
+// number of bytes hashed.
+static long dedupe() {
+  long hashed = 0;
+  int *order = malloc(sizeof(int) * files_count);
+  for (int i = 0; i < files_count; ++i) {
+    order[i] = i;
+  }
+  qsort(order, files_count, sizeof(int), compare_files);
+
+  for (int from = 0; from < files_count;) {
+    off_t size = infos[order[from]].size;
+    int to = from + 1;
+    while (to < files_count && infos[order[to]].size == size) {
+      ++to;
+    }
+    if (to - from == 1) {
+      from = to;
+      continue;
+    }
+
+    // hash this bucket, then sort it by hash (files which can't be read keep a zero hash)
+    for (int i = from; i < to && size; ++i) {
+      char *p = map_path(files[order[i]], size);
+      if (p) {
+        infos[order[i]].hash = hash_bytes(p, size);
+        munmap(p, size);
+        hashed += size;
+      }
+    }
+    qsort(order + from, to - from, sizeof(int), compare_files);
+
+    // compare each file against the first with the same hash
+    for (int i = from; i < to;) {
+      int first = order[i];
+      int j = i + 1;
+      while (j < to && infos[order[j]].hash == infos[first].hash) {
+        ++j;
+      }
+      char *a = j - i > 1 && size ? map_path(files[first], size) : NULL;
+      for (int k = i + 1; k < j; ++k) {
+        char *b = size ? map_path(files[order[k]], size) : NULL;
+        if (size == 0 || (a && b && !memcmp(a, b, size))) {
+          infos[order[k]].canonical = first;
+          ++infos[first].duplicates;
+        }
+        if (b) {
+          munmap(b, size);
+        }
+      }
+      if (a) {
+        munmap(a, size);
+      }
+      i = j;
+    }
+    from = to;
+  }
+
+  free(order);
+  return hashed;
+}
+
+static int take(int self) {
+  deque *own = &deques[self];
+  int index = -1;
+
+  pthread_mutex_lock(&own->lock);
+  if (own->tail > own->head) {
+    index = own->items[--own->tail];
+  }
+  pthread_mutex_unlock(&own->lock);
+  if (index >= 0) {
+    return index;
+  }
+
+  // steal from the head of others, starting with our neighbour
+  for (int i = 1; i < workers_count; ++i) {
+    deque *other = &deques[(self + i) % workers_count];
+    pthread_mutex_lock(&other->lock);
+    if (other->tail > other->head) {
+      index = other->items[other->head++];
+    }
+    pthread_mutex_unlock(&other->lock);
+    if (index >= 0) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+static void file_callback(void *user, struct token *t) {
+  file_state *state = user;
+  ++state->tokens;
+
+  // nb. this includes dynamic imports, which also have SPECIAL__DYNAMIC
+  if (!(t->special & SPECIAL__EXTERNAL) || t->type != TOKEN_STRING || t->len < 2) {
+    return;
+  }
+  if (quiet) {
+    return;
+  }
+  if (state->imports++) {
+    out_write(state->out, ",", 1);
+  }
+  out_json_string(state->out, t->p + 1, t->len - 2);
+}
+
+static void parse_file(worker *w, int index) {
+  const char *path = files[index];
+  file_info *info = &infos[index];
+  outbuf *out = &w->out;
+  if (!quiet) {
+    out_write(out, "{\"file\":", 8);
+    out_json_string(out, path, strlen(path));
+  }
+  size_t mark = out->len;
+
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    ++w->errors;
+    info->failed = 1;
+    if (!quiet) {
+      out_printf(out, ",\"error\":{\"message\":\"could not read\"}}\n");
+    }
+    goto done;
+  }
+
+  // the parser works in int offsets, so larger files can't be parsed at all
+  if (st.st_size > INT_MAX) {
+    close(fd);
+    ++w->errors;
+    info->failed = 1;
+    if (!quiet) {
+      out_printf(out, ",\"error\":{\"message\":\"too large\"}}\n");
+    }
+    goto done;
+  }
+
+  int len = st.st_size;
+  // nb. mmap fails for empty files, but any non-NULL pointer will do
+  char *p = len ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+  close(fd);
+  if (p == MAP_FAILED) {
+    ++w->errors;
+    info->failed = 1;
+    if (!quiet) {
+      out_printf(out, ",\"error\":{\"message\":\"could not map\"}}\n");
+    }
+    goto done;
+  }
+
+  if (!quiet) {
+    out_printf(out, ",\"bytes\":%d,\"imports\":[", len);
+  }
+  file_state state = {out, 0, 0};
+  gumnut_handlers h = {file_callback, NULL, NULL, &state};
+  int ret = scan_only ? gumnut_scan(p, len, &h) : gumnut_run(p, len, &h);
+
+  w->bytes += len;
+  w->tokens += state.tokens;
+  info->tokens = state.tokens;
+  if (!quiet) {
+    out_printf(out, "],\"tokens\":%ld", state.tokens);
+  }
+  if (ret < 0) {
+    ++w->errors;
+    info->failed = 1;
+    struct token *cursor = gumnut_cursor();
+    if (!quiet) {
+      out_printf(out, ",\"error\":{\"code\":%d,\"line\":%d,\"at\":%ld}", ret, cursor->line_no,
+          (long) (cursor->p - p));
+    }
+  }
+  if (!quiet) {
+    out_write(out, "}\n", 2);
+  }
+
+  if (len) {
+    munmap(p, len);
+  }
+
+done:
+  if (info->duplicates && !quiet) {
+    info->result = strndup(out->buf + mark, out->len - mark);
+  }
+}
+
+static void *work(void *arg) {
+  worker *w = arg;
+
+  // brackets deeper than this would exceed the parser's own depth limit
+  int *arena = malloc(sizeof(int) * PARSER_MAX_DEPTH);
+  blep_token_arena(arena, PARSER_MAX_DEPTH);
+
+  int index;
+  while ((index = take(w->index)) >= 0) {
+    parse_file(w, index);
+    if (w->out.len >= FLUSH_AT) {
+      out_flush(&w->out);
+    }
+  }
+  out_flush(&w->out);
+  blep_token_arena(NULL, 0);
+  free(arena);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while ((opt = getopt(argc, argv, "j:sqD")) != -1) {
+    switch (opt) {
+      case 'j':
+        threads = atoi(optarg);
+        break;
+      case 's':
+        scan_only = 1;
+        break;
+      case 'q':
+        quiet = 1;
+        break;
+      case 'D':
+        no_dedupe = 1;
+        break;
+      default:
+        return 1;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "usage: %s [-j threads] [-s] [-q] [-D] <file|dir|glob...>\n", argv[0]);
+    return 1;
+  }
+  for (int i = optind; i < argc; ++i) {
+    add_path(argv[i]);
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  long hashed = no_dedupe ? 0 : dedupe();
+  int *unique = malloc(sizeof(int) * (files_count + 1));
+  int unique_count = 0;
+  for (int i = 0; i < files_count; ++i) {
+    if (infos[i].canonical == i) {
+      unique[unique_count++] = i;
+    }
+  }
+
+  if (threads < 1) {
+    threads = 1;
+  }
+  if (threads > unique_count) {
+    threads = unique_count ? unique_count : 1;
+  }
+  workers_count = threads;
+  deques = calloc(threads, sizeof(deque));
+  workers = calloc(threads, sizeof(worker));
+
+  // Give each worker a contiguous run of files, so nearby files are usually parsed together.
+  for (int i = 0; i < threads; ++i) {
+    int from = (long) unique_count * i / threads;
+    int to = (long) unique_count * (i + 1) / threads;
+    deque *d = &deques[i];
+    pthread_mutex_init(&d->lock, NULL);
+    d->items = malloc(sizeof(int) * (to - from + 1));
+    // the owner pops from the tail, so store in reverse to parse in order
+    for (int j = to - 1; j >= from; --j) {
+      d->items[d->tail++] = unique[j];
+    }
+  }
+
+  // the default thread stack may be too small for the deepest nesting the parser allows
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, PARSER_STACK_SIZE);
+  for (int i = 0; i < threads; ++i) {
+    workers[i].index = i;
+    pthread_create(&workers[i].thread, &attr, work, &workers[i]);
+  }
+  pthread_attr_destroy(&attr);
+
+  long bytes = 0;
+  long tokens = 0;
+  int errors = 0;
+  for (int i = 0; i < threads; ++i) {
+    pthread_join(workers[i].thread, NULL);
+    bytes += workers[i].bytes;
+    tokens += workers[i].tokens;
+    errors += workers[i].errors;
+  }
+
+  // fan out results to duplicates
+  long skipped = 0;
+  outbuf out = {0};
+  for (int i = 0; i < files_count; ++i) {
+    file_info *canonical = &infos[infos[i].canonical];
+    if (canonical == &infos[i]) {
+      continue;
+    }
+    skipped += infos[i].size;
+    tokens += canonical->tokens;
+    errors += canonical->failed;
+    if (!quiet) {
+      out_write(&out, "{\"file\":", 8);
+      out_json_string(&out, files[i], strlen(files[i]));
+      out_write(&out, ",\"duplicate\":", 13);
+      out_json_string(&out, files[infos[i].canonical], strlen(files[infos[i].canonical]));
+      out_write(&out, canonical->result, strlen(canonical->result));
+      if (out.len >= FLUSH_AT) {
+        out_flush(&out);
+      }
+    }
+  }
+  out_flush(&out);
+  bytes += skipped;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  double mb = (double) bytes / (1024 * 1024);
+
+  fprintf(stderr, "files=%d bytes=%ld tokens=%ld errors=%d threads=%d\n", files_count, bytes, tokens,
+      errors, threads);
+  if (!no_dedupe) {
+    fprintf(stderr, "unique=%d duplicates=%d hashed=%ld skipped=%ld (%.1f%% of bytes)\n", unique_count,
+        files_count - unique_count, hashed, skipped, bytes ? 100.0 * skipped / bytes : 0.0);
+  }
+  fprintf(stderr, "time=%.3fs throughput=%.2fMB/s\n", seconds, seconds > 0 ? mb / seconds : 0.0);
+  return errors ? 2 : 0;
+}
@@ -37,6 +37,8 @@
 #define SPECIAL__EXTERNAL        32   // is an external reference (import/export)
 #define SPECIAL__DESTRUCTURING   64   // on { or [
 #define SPECIAL__DEFAULT         128  // this is also the default export (on class/func)
+#define SPECIAL__DYNAMIC         256  // string target of import(), also has SPECIAL__EXTERNAL
+#define SPECIAL__META            512  // "meta" of import.meta
 #define SPECIAL__LIT             (1 << 30)
 
 
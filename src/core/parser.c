@@ -40,9 +40,25 @@ static int consume_expr_zero_many(int);
 static int consume_expr_internal(int);
 static int consume_definition_list(int, int);
 static int consume_destructuring(int);
+static int consume_import_call();
 
 
-static int parser_skip = 0;
+static _THREAD_LOCAL int parser_skip = 0;
+static _THREAD_LOCAL int parser_scan = 0;  // only module statements are being parsed, see blep_parser_scan
+static _THREAD_LOCAL int parser_depth = 0;  // nested statements and exprs, see PARSER_MAX_DEPTH
+
+// Results of destructuring lookahead, keyed by the bracket's position. Looking ahead from one
+// bracket also decides every bracket nested within it, so these are recorded and reused as the
+// parse descends, rather than looking ahead again at each level: otherwise deeply nested arrays or
+// objects (e.g., generated data) take quadratic time. Entries from earlier inputs are ignored via
+// the generation, which changes on every blep_parser_init.
+#define DESTRUCTURING_MEMO 1024
+static _THREAD_LOCAL struct {
+  char *p;
+  unsigned int result;  // generation << 1 | is_destructuring
+} destructuring_memo[DESTRUCTURING_MEMO];
+static _THREAD_LOCAL unsigned int destructuring_generation = 0;
+static _THREAD_LOCAL int destructuring_lookahead = 0;
 
 
 #define cursor (&(td->curr))
@@ -51,12 +67,50 @@ static int parser_skip = 0;
 
 // emit cursor and continue
 static inline int cursor_next() {
+#ifndef BLEP_VALIDATE
   if (!parser_skip) {
     blep_parser_callback();
   }
+#endif
   return blep_token_next();
 }
 
+static int consume_statement_nested(int);
+static int consume_expr_nested(int);
+
+// Statements and exprs can nest without brackets (e.g., `if (a) if (b) ...` or `a => b => ...`),
+// so aren't limited by the tokenizer's STACK_SIZE. Each level uses about 100 bytes of C stack, so
+// cap their depth rather than overflowing it.
+static int consume_statement(int mode) {
+  if (++parser_depth > PARSER_MAX_DEPTH) {
+    debugf("statement nested too deeply");
+    --parser_depth;
+    return ERROR__STACK;
+  }
+  int ret = consume_statement_nested(mode);
+  --parser_depth;
+  return ret;
+}
+
+static int consume_expr_internal(int is_statement) {
+  if (++parser_depth > PARSER_MAX_DEPTH) {
+    debugf("expr nested too deeply");
+    --parser_depth;
+    return ERROR__STACK;
+  }
+  int ret = consume_expr_nested(is_statement);
+  --parser_depth;
+  return ret;
+}
+
+#ifdef BLEP_VALIDATE
+
+// stacks are never announced (or skipped), so only their scope remains
+#define _STACK_BEGIN(type) {
+#define _STACK_END() ; }
+
+#else
+
 // begins an optional stack (client can ignore it)
 #define _STACK_BEGIN(type) { \
   const int _stack_type = type; \
@@ -69,6 +123,8 @@ static inline int cursor_next() {
   parser_skip = _prev_parser_skip; \
 }
 
+#endif
+
 // ends an optional stack _and_ consumes an upcoming semicolon on same line
 #define _STACK_END_SEMICOLON() \
     if (cursor->type == TOKEN_SEMICOLON && cursor->special == 0) { \
@@ -438,6 +494,22 @@ static int consume_template_string() {
   }
 }
 
+static void record_destructuring(char *p, int is_destructuring) {
+  int index = ((uintptr_t) p) % DESTRUCTURING_MEMO;
+  destructuring_memo[index].p = p;
+  destructuring_memo[index].result = (destructuring_generation << 1) | is_destructuring;
+}
+
+// returns 0 or 1 if a lookahead from p has already been decided, or -1 if not
+static int recall_destructuring(char *p) {
+  int index = ((uintptr_t) p) % DESTRUCTURING_MEMO;
+  unsigned int result = destructuring_memo[index].result;
+  if (destructuring_memo[index].p != p || (result >> 1) != (destructuring_generation & 0x7fffffff)) {
+    return -1;
+  }
+  return result & 1;
+}
+
 static int maybe_consume_destructuring() {
   // look for e.g. `[a] = ..` or `{} = ...`; array or brace with equals following
   switch (cursor->type) {
@@ -449,13 +521,18 @@ static int maybe_consume_destructuring() {
       return 0;
   }
 
-  int is_destructuring = 0;
+  int is_destructuring = parser_skip ? 0 : recall_destructuring(cursor->p);
+  if (is_destructuring == -1) {
+    is_destructuring = 0;
 
-  _SET_RESTORE();
-  // thankfully, destructuring isn't allowed inside parens (e.g. `({x}) = {x}` is invalid), so just
-  // check for equals here.
-  is_destructuring = (consume_destructuring(0) == 0) && cursor->special == MISC_EQUALS;
-  _RESUME_RESTORE();
+    _SET_RESTORE();
+    // thankfully, destructuring isn't allowed inside parens (e.g. `({x}) = {x}` is invalid), so
+    // just check for equals here.
+    ++destructuring_lookahead;
+    is_destructuring = (consume_destructuring(0) == 0) && cursor->special == MISC_EQUALS;
+    --destructuring_lookahead;
+    _RESUME_RESTORE();
+  }
 
   debugf("lookahead got destructuring: %d", is_destructuring);
   if (is_destructuring) {
@@ -541,7 +618,7 @@ static int is_token_assign_like(struct token *t) {
 }
 
 // like the other, but counts ()'s
-static int consume_expr_internal(int is_statement) {
+static int consume_expr_nested(int is_statement) {
   int paren_count = 0;
 
 restart_expr:
@@ -610,6 +687,11 @@ restart_expr:
             }
             break;
 
+          case LIT_IMPORT:
+            // "import(...)" or "import.meta", any other use is invalid
+            cursor->type = TOKEN_KEYWORD;
+            break;
+
           case LIT_NEW:
             blep_token_peek();
             if (peek->special != MISC_DOT) {
@@ -642,6 +724,28 @@ restart_expr:
           case LIT_CLASS:
             _check(consume_class(0));
             continue;
+
+          case LIT_IMPORT:
+            blep_token_peek();
+            if (peek->type == TOKEN_PAREN) {
+              _STACK_BEGIN(STACK__MODULE);
+              _check(consume_import_call());
+              _STACK_END();
+              continue;
+            } else if (peek->special != MISC_DOT) {
+              break;
+            }
+
+            // import.meta
+            cursor_next();
+            cursor_next();
+            if (cursor->type != TOKEN_LIT) {
+              debugf("expected lit after import.");
+              return ERROR__UNEXPECTED;
+            }
+            cursor->special = SPECIAL__PROPERTY | SPECIAL__META;
+            cursor_next();
+            continue;
         }
 
         cursor_next();  // invalid but allow anyway
@@ -660,8 +764,7 @@ restart_expr:
       case TOKEN_TERNARY:
         // nb. needs value on left (and contents!), but nonsensical otherwise
         _check(consume_expr_group());
-        value_line = 0;
-        continue;
+        goto restart_expr;  // the right-hand side may be an arrowfunc
 
       case TOKEN_PAREN:
         if (value_line) {
@@ -884,9 +987,21 @@ static inline int consume_expr(int is_statement) {
   return 0;
 }
 
+static int consume_destructuring_nested(int);
+
 // consume destructuring: this is not always __DECLARE, because it could be in an expr
 // special will contain SPECIAL__TOP or SPECIAL__DECLARE
 static int consume_destructuring(int special) {
+  char *p = cursor->p;
+  int ret = consume_destructuring_nested(special);
+  if (destructuring_lookahead && !special) {
+    // nested brackets are parsed exactly as a lookahead from them would be, so record the result
+    record_destructuring(p, ret == 0 && cursor->special == MISC_EQUALS);
+  }
+  return ret;
+}
+
+static int consume_destructuring_nested(int special) {
 #ifdef DEBUG
   int special_mask = (SPECIAL__TOP | SPECIAL__DECLARE);
   if ((special | special_mask) != special_mask) {
@@ -1324,6 +1439,40 @@ static int consume_import_module_list() {
   }
 }
 
+// consumes `import(...)`, marking a plain string specifier as external
+static int consume_import_call() {
+#ifdef DEBUG
+  if (cursor->special != LIT_IMPORT) {
+    debugf("missing import keyword");
+    return ERROR__UNEXPECTED;
+  }
+#endif
+  cursor->type = TOKEN_KEYWORD;
+  cursor_next();
+
+  if (cursor->type != TOKEN_PAREN) {
+    debugf("expected ( after import");
+    return ERROR__UNEXPECTED;
+  }
+  cursor_next();
+
+  // only the first argument is the specifier (the second is options), and it must be on its own
+  if (cursor->type == TOKEN_STRING && !(cursor->p[0] == '`' && (cursor->len == 1 || cursor->p[cursor->len - 1] != '`'))) {
+    blep_token_peek();
+    if (peek->type == TOKEN_CLOSE || peek->special == MISC_COMMA) {
+      cursor->special = SPECIAL__EXTERNAL | SPECIAL__DYNAMIC;
+    }
+  }
+
+  _check(consume_expr_zero_many(0));
+  if (cursor->type != TOKEN_CLOSE) {
+    debugf("expected ) after import call");
+    return ERROR__UNEXPECTED;
+  }
+  cursor_next();
+  return 0;
+}
+
 static int consume_import() {
 #ifdef DEBUG
   if (cursor->special != LIT_IMPORT) {
@@ -1500,8 +1649,16 @@ static int consume_export_wrap() {
     _STACK_END_SEMICOLON();
   } else {
     _STACK_BEGIN(STACK__EXPORT);
-    _check(consume_export_declare());
-    _STACK_END_SEMICOLON();
+    if (parser_scan && parser_skip) {
+      // nothing to announce, so the scanner can skip the declaration
+      cursor_next();
+    } else {
+      _check(consume_export_declare());
+      if (cursor->type == TOKEN_SEMICOLON && cursor->special == 0) {
+        cursor_next();
+      }
+    }
+    _STACK_END();
   }
 
   return 0;
@@ -1697,7 +1854,7 @@ static int consume_expr_statement() {
   return 0;
 }
 
-static int consume_statement(int mode) {
+static int consume_statement_nested(int mode) {
   switch (cursor->type) {
     case TOKEN_EOF:
     case TOKEN_COLON:
@@ -1875,10 +2032,10 @@ static int consume_statement(int mode) {
   if (!(cursor->special & _MASK_MASQUERADE)) {
     if (blep_token_peek() == TOKEN_COLON) {
       // nb. "await:" is invalid in async functions, but it's nonsensical anyway
-      // we restart this function to parse as label
+      // we restart this function to parse as label (which isn't more nested)
       cursor->special = 0;
       cursor->type = TOKEN_LABEL;
-      return consume_statement(0);
+      return consume_statement_nested(0);
     }
   }
 
@@ -1907,8 +2064,12 @@ EMSCRIPTEN_KEEPALIVE
 int blep_parser_init(char *p, int len) {
   _check(blep_token_init(p, len));
   parser_skip = 0;
+  parser_scan = 0;
+  parser_depth = 0;
+  destructuring_lookahead = 0;
+  ++destructuring_generation;
 
-  if (p[0] == '#' && p[1] == '!') {
+  if (len >= 2 && p[0] == '#' && p[1] == '!') {
     td->at = memchr(p, '\n', td->end - p);
     if (td->at == NULL) {
       td->at = p + len;
@@ -1921,6 +2082,8 @@ int blep_parser_init(char *p, int len) {
   return 0;
 }
 
+// Runners built for module statements only (see "src/harness/build.sh") leave this out.
+#ifndef BLEP_IMPORTS_ONLY
 EMSCRIPTEN_KEEPALIVE
 int blep_parser_run() {
   if (cursor->type == TOKEN_EOF) {
@@ -1937,6 +2100,105 @@ int blep_parser_run() {
   }
   return len;
 }
+#endif
+
+// the depth at the cursor (rather than the head), undoing the effect of any peeked token
+static int cursor_depth() {
+  if (!peek->p) {
+    return td->depth;
+  }
+
+  switch (peek->type) {
+    case TOKEN_CLOSE:
+      return td->depth + 1;
+
+    case TOKEN_BRACE:
+    case TOKEN_ARRAY:
+    case TOKEN_PAREN:
+    case TOKEN_TERNARY:
+      return td->depth - 1;
+
+    case TOKEN_STRING: {
+      // template strings open with "`...${" and close with "}...`"
+      char last = peek->p[peek->len - 1];
+      if (peek->p[0] == '`' && last == '{') {
+        return td->depth - 1;
+      } else if (peek->p[0] == '}' && last == '`') {
+        return td->depth + 1;
+      }
+    }
+  }
+
+  return td->depth;
+}
+
+// does lookahead to check for `import(...) {`, a method named "import" in a class body or object
+// literal rather than a dynamic import
+static int lookahead_is_import_method() {
+  cursor_next();  // import
+  cursor_next();  // (
+
+  if (consume_definition_list(0, 0) || cursor->type != TOKEN_CLOSE) {
+    return 0;  // not a valid parameter list, so a call
+  }
+  cursor_next();
+  return cursor->type == TOKEN_BRACE;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int blep_parser_scan() {
+  if (cursor->type == TOKEN_EOF) {
+    return 0;
+  }
+  char *head = cursor->p;
+  parser_scan = 1;
+
+  // Skip until a module statement or `import(...)`, only balancing brackets. This relies on the
+  // tokenizer's guess for regexp vs divide, which is the only real ambiguity here.
+  for (;;) {
+    if (cursor->type == TOKEN_EOF) {
+      if (td->depth != 1) {
+        debugf("scan finished with bad depth=%d", td->depth);
+        return ERROR__STACK;
+      }
+      return cursor->p - head;
+    }
+
+    if (cursor->type == TOKEN_LIT) {
+      if (cursor->special == LIT_IMPORT) {
+        int is_top = (cursor_depth() == 1);
+        blep_token_peek();
+
+        if (peek->type == TOKEN_PAREN) {
+          int is_method = 0;
+          _SET_RESTORE();
+          is_method = lookahead_is_import_method();
+          _RESUME_RESTORE();
+
+          if (!is_method) {
+            _STACK_BEGIN(STACK__MODULE);
+            _check(consume_import_call());
+            _STACK_END();
+            break;
+          }
+        } else if (is_top && peek->special != MISC_DOT) {
+          _check(consume_statement(STATEMENT__TOP));
+          break;
+        }
+      } else if (cursor->special == LIT_EXPORT && cursor_depth() == 1) {
+        _check(consume_statement(STATEMENT__TOP));
+        break;
+      }
+    }
+
+    int ret = blep_token_next();
+    if (ret < 0) {
+      return ret;
+    }
+  }
+
+  return cursor->p - head;
+}
 
 EMSCRIPTEN_KEEPALIVE
 struct token *blep_parser_cursor() {
@@ -5,11 +5,25 @@
 #include "token.h"
 #include "def.h"
 
+// Maximum nesting of statements and exprs, which each use C stack (see consume_statement). The
+// default needs about 700KB of stack when optimized, or 2MB without, which suits typical threads. Binaries which parse on their own
+// PARSER_STACK_SIZE threads raise it with -DPARSER_MAX_DEPTH (the CLIs use 49152, which allows 10k
+// nested callbacks, as a call passed a callback like `f(() => {` nests four).
+#ifndef PARSER_MAX_DEPTH
+#define PARSER_MAX_DEPTH 4096
+#endif
+
+// C stack for a thread which parses as deep as PARSER_MAX_DEPTH. Each level uses up to about 160
+// bytes when optimized, but nearly 460 bytes without.
+#define PARSER_STACK_SIZE ((long) PARSER_MAX_DEPTH * 512)
+
 int blep_parser_init(char *, int);
 int blep_parser_run();
+int blep_parser_scan();
 struct token *blep_parser_cursor();
 
-// below must be provided
+// below must be provided, unless built with BLEP_VALIDATE, which compiles out all emission so the
+// parser only reports success or failure
 
 void blep_parser_callback();
 int blep_parser_open(int);
@@ -8,10 +8,19 @@
 
 #include "token-tables.h"
 
+#ifdef EMSCRIPTEN
+#include <emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE
+#endif
+
 #ifndef EMSCRIPTEN
-tokendef _td;
+_THREAD_LOCAL tokendef _td;
 #endif
 
+static _THREAD_LOCAL int *arena;
+static _THREAD_LOCAL int arena_cap;
+
 #ifndef NULL
 #define NULL ((char*)0)
 #endif
@@ -23,24 +32,51 @@ tokendef _td;
 #define debugf (void)sizeof
 #endif
 
+// reads p[i], or zero if this is past the end of input (which need not be NULL-terminated)
+static inline char blepi_peek_at(char *p, int i) {
+  return p + i < td->end ? p[i] : 0;
+}
+
+// longest known lit (e.g. "instanceof"), which is read without bounds checks
+#define _LIT_MAX 16
 
+
+EMSCRIPTEN_KEEPALIVE
 int blep_token_init(char *p, int len) {
   bzero(td, sizeof(tokendef));
 
   td->at = p;
+  td->start = p;
   td->end = p + len;
   td->line_no = 1;
   td->depth = 1;
+  td->stack = td->stack_inline;
+  td->stack_cap = STACK_SIZE;
 
-  // sanity-check td->end is NULL
-  if (len < 0 || td->end[0]) {
-    debugf("got bad td->end");
+  if (len < 0) {
+    debugf("got bad len");
     return ERROR__UNEXPECTED;
   }
 
   return 0;
 }
 
+void blep_token_arena(int *p, int cap) {
+  arena = p;
+  arena_cap = p ? cap : 0;
+}
+
+// moves the stack into the arena once the inline stack is full, returning zero if it can't grow
+static int blepi_grow_stack() {
+  if (td->stack != td->stack_inline || arena_cap <= STACK_SIZE) {
+    return 0;
+  }
+  memcpy(arena, td->stack_inline, sizeof(int) * STACK_SIZE);
+  td->stack = arena;
+  td->stack_cap = arena_cap;
+  return 1;
+}
+
 // consume regexp "/foobar/"
 static inline int blepi_consume_slash_regexp(char *p) {
 #ifdef DEBUG
@@ -63,7 +99,7 @@ static inline int blepi_consume_slash_regexp(char *p) {
         // eat trailing flags
         do {
           ++p;
-        } while (isalnum(*p));
+        } while (p < td->end && isalnum(*p));
         return p - start;
 
       case '\n':
@@ -77,25 +113,27 @@ static inline int blepi_consume_slash_regexp(char *p) {
         is_charexpr = 0;
         continue;
 
-      case '\\':
-        if (p[1] == '/' || p[1] == '[' || p[1] == '\\') {
+      case '\\': {
+        char next = blepi_peek_at(p, 1);
+        if (next == '/' || next == '[' || next == '\\') {
           ++p;  // we can only escape these
         }
         continue;
+      }
     }
   }
 
-  return p - start;
+  return td->end - start;
 }
 
 static inline int blepi_maybe_consume_alnum_group(char *p) {
-  if (p[0] != '{') {
+  if (blepi_peek_at(p, 0) != '{') {
     return 0;
   }
 
   int len = 1;
   for (;;) {
-    char c = p[len];
+    char c = blepi_peek_at(p, len);
     ++len;
 
     if (c == '}') {
@@ -116,24 +154,22 @@ static inline int blepi_consume_basic_string(char *p, int *line_no) {
   char *start = p;
 
   for (;;) {
-    ++p;
+    if (++p >= td->end) {
+      return td->end - start;
+    }
     switch (*p) {
-      case '\0':
-        if (td->end == p) {
-          return p - start;
-        }
-        continue;
-
       case '\n':
         // nb. not valid here
         ++(*line_no);
         continue;
 
-      case '\\':
-        if (p[1] == *start || p[1] == '\\') {
+      case '\\': {
+        char next = blepi_peek_at(p, 1);
+        if (next == *start || next == '\\') {
           ++p;  // the only things we care about escaping
         }
         continue;
+      }
 
       case '"':
       case '\'':
@@ -157,26 +193,24 @@ static inline int blepi_consume_template(char *p, int *line_no) {
   char *start = p;
 
   for (;;) {
-    ++p;
+    if (++p >= td->end) {
+      return td->end - start;
+    }
     switch (*p) {
-      case '\0':
-        if (td->end == p) {
-          return p - start;
-        }
-        continue;
-
       case '\n':
         ++(*line_no);
         continue;
 
-      case '\\':
-        if (p[1] == '$' || p[1] == '`' || p[1] == '\\') {
+      case '\\': {
+        char next = blepi_peek_at(p, 1);
+        if (next == '$' || next == '`' || next == '\\') {
           ++p;  // we can only escape these
         }
         continue;
+      }
 
       case '$':
-        if (p[1] == '{') {
+        if (blepi_peek_at(p, 1) == '{') {
           return 2 + p - start;
         }
         continue;
@@ -192,7 +226,7 @@ static inline int blepi_consume_void(char *p, int *line_no) {
   int line_no_delta = 0;
   char *start = p;
 
-  for (;;) {
+  while (p < td->end) {
     switch (*p) {
       case ' ':    // 32
       case '\t':   //  9
@@ -208,7 +242,7 @@ static inline int blepi_consume_void(char *p, int *line_no) {
         continue;
 
       case '/': {  // 47
-        char next = p[1];
+        char next = blepi_peek_at(p, 1);
         if (next == '/') {
           p = memchr(p, '\n', td->end - p);
           if (p == 0) {
@@ -221,18 +255,17 @@ static inline int blepi_consume_void(char *p, int *line_no) {
 
         // consuming multiline
         // nb. this can't use memchr because it's looking for both * and \n
-        p += 2;
-        do {
+        for (p += 2; p < td->end; ++p) {
           char c = *p;
           if (c == '*') {
-            if (p[1] == '/') {
+            if (blepi_peek_at(p, 1) == '/') {
               p += 2;
               break;
             }
           } else if (c == '\n') {
             ++line_no_delta;
           }
-        } while (++p < td->end);
+        }
         continue;
       }
     }
@@ -253,12 +286,12 @@ static inline int blepi_consume_number(char *p) {
   }
 #endif
   int len = 1;
-  char c = p[1];
+  char c = blepi_peek_at(p, 1);
   for (;;) {
     if (!(isalnum(c) || c == '.' || c == '_')) {  // letters, dots, etc- misuse is invalid, so eat anyway
       break;
     }
-    c = p[++len];
+    c = blepi_peek_at(p, ++len);
   }
   return len;
 }
@@ -271,12 +304,19 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
       if (td->depth < td->restore__depth) { \
         debugf("got stack increment below restore depth: was=%d, depth=%d", td->depth, td->restore__depth); \
         _ret(0, TOKEN_EOF); \
-      } else if (++td->depth == STACK_SIZE) { \
+      } else if (++td->depth == td->stack_cap && !blepi_grow_stack()) { \
         debugf("hit stack upper limit"); \
         _ret(0, TOKEN_EOF); \
       } \
     }
 
+  // bytes remaining, as the input need not be NULL-terminated
+  const int avail = td->end - p;
+  if (avail <= 0) {
+    _ret(0, TOKEN_EOF);
+  }
+#define _peek(_i) ((_i) < avail ? p[_i] : 0)
+
   struct token *prev = &(td->curr);
   const unsigned char initial = p[0];
   int op = lookup_op[initial];
@@ -288,9 +328,10 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
     case _LOOKUP__OP_3: {
       op &= 3;  // remove 32 bit, just use 1,2 bits
       len = 1;
-      char c = p[len];
+      char c = _peek(len);
       while (len < op && c == initial) {
-        c = p[++len];
+        ++len;
+        c = _peek(len);
       }
 
       if (len == 1) {
@@ -320,7 +361,8 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
           ++len;  // eat || or &&: but no more
         } else if (c == '=') {
           // consume a suffix '=' (or whole ===, !==)
-          c = p[++len];
+          ++len;
+          c = _peek(len);
           if (c == '=' && (initial == '=' || initial == '!')) {
             ++len;
           }
@@ -337,19 +379,19 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
     }
 
     case _LOOKUP__DOT:
-      if (isdigit(p[1])) {
+      if (isdigit(_peek(1))) {
         _ret(blepi_consume_number(p), TOKEN_NUMBER);
-      } else if (p[1] == '.' && p[2] == '.') {
+      } else if (_peek(1) == '.' && _peek(2) == '.') {
         _reth(3, TOKEN_OP, MISC_SPREAD);
       }
       _reth(1, TOKEN_OP, MISC_DOT);
 
     case _LOOKUP__Q:
-      switch (p[1]) {
+      switch (_peek(1)) {
         case '.':
           _reth(2, TOKEN_OP, MISC_CHAIN);  // "?." operator
         case '?':
-          if (p[2] == '=') {
+          if (_peek(2) == '=') {
             _ret(3, TOKEN_OP);
           }
           _ret(2, TOKEN_OP);
@@ -404,9 +446,16 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
       // don't hash if this is a property
       if (prev->special != MISC_DOT && prev->special != MISC_CHAIN) {
         t->special = 0;
-        len = consume_known_lit(p, &(t->special));
+        if (avail > _LIT_MAX) {
+          len = consume_known_lit(p, &(t->special));
+        } else {
+          // near the end of input, so match against a NULL-terminated copy
+          char tail[_LIT_MAX + 1] = {0};
+          memcpy(tail, p, avail);
+          len = consume_known_lit(tail, &(t->special));
+        }
 
-        char c = p[len];
+        char c = _peek(len);
         if (!lookup_symbol[c]) {
           t->type = TOKEN_LIT;
           t->len = len;
@@ -417,14 +466,15 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
     }
 
     case _LOOKUP__SYMBOL: {
-      char c = p[len];  // don't need to check this one, we know it's valid
+      char c = _peek(len);
       do {
         if (c != '\\') {
-          c = p[++len];
+          ++len;
+          c = _peek(len);
           continue;
         }
 
-        if (p[len + 1] != 'u') {
+        if (_peek(len + 1) != 'u') {
           break;
         }
         len += 2;
@@ -435,7 +485,7 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
           _ret(0, TOKEN_EOF);  // -1 if group doesn't close properly
         }
         len += group;
-        c = p[len];
+        c = _peek(len);
       } while (lookup_symbol[c]);
 
       _ret(len, TOKEN_LIT);
@@ -514,6 +564,7 @@ static inline void blepi_consume_token(struct token *t, char *p, int *line_no) {
 #undef _ret
 #undef _reth
 #undef _inc_stack
+#undef _peek
 }
 
 int blep_token_update(int type) {
@@ -562,6 +613,75 @@ int blep_token_update(int type) {
   return ERROR__INTERNAL;
 }
 
+_Static_assert(sizeof(struct token_record) == 16, "`struct token_record` should be 16 bytes");
+_Static_assert(_TOKEN_MAX < (1 << _RECORD_TYPE_BITS), "token types should fit in record");
+
+void blep_token_record(struct token_record *out, struct token *t) {
+  out->at = t->p - td->start;
+  out->len = t->len;
+  out->special = t->special;
+  out->line_type = ((uint32_t) t->line_no << _RECORD_TYPE_BITS) | t->type;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int blep_token_records(struct token_record *out, int cap) {
+  int count = 0;
+  while (count < cap) {
+    int type = blep_token_next();
+    if (type <= 0) {
+      return type < 0 ? type : count;
+    }
+    blep_token_record(out + count++, &(td->curr));
+  }
+  return count;
+}
+
+// Only the native chunked lexer (see "src/lib/lexer.h") snapshots and resumes, so runners leave this
+// out, along with its runtime-sized copies of the stack.
+#ifndef EMSCRIPTEN
+
+void blep_token_snapshot(struct token_snapshot *s) {
+  s->at = td->at - td->start;
+  s->line_no = td->line_no;
+  s->prev.at = td->curr.p ? td->curr.p - td->start : s->at;
+  s->prev.len = td->curr.len;
+  s->prev.special = td->curr.special;
+  s->prev.line_type = ((uint32_t) td->curr.line_no << _RECORD_TYPE_BITS) | td->curr.type;
+  s->depth = td->depth;
+  memcpy(s->stack, td->stack, sizeof(int) * (td->depth < STACK_SIZE ? td->depth : STACK_SIZE));
+}
+
+int blep_token_resume(char *p, int len, const struct token_snapshot *s, uint32_t shift) {
+  int ret = blep_token_init(p, len);
+  if (ret < 0) {
+    return ret;
+  }
+  if (shift > s->prev.at || s->at - shift > (uint32_t) len || s->depth <= 0 ||
+      (s->depth >= STACK_SIZE && s->depth >= arena_cap)) {
+    debugf("bad resume: shift=%u prev=%u at=%u len=%d", shift, s->prev.at, s->at, len);
+    return ERROR__INTERNAL;
+  }
+
+  td->at = p + (s->at - shift);
+  td->line_no = s->line_no;
+  td->depth = s->depth;
+  if (s->depth >= STACK_SIZE) {
+    blepi_grow_stack();  // deeper entries are still in the arena
+  }
+  memcpy(td->stack, s->stack, sizeof(int) * (s->depth < STACK_SIZE ? s->depth : STACK_SIZE));
+
+  // nb. the void before the previous token may have been dropped, but it's never read
+  td->curr.p = td->curr.vp = p + (s->prev.at - shift);
+  td->curr.len = s->prev.len;
+  td->curr.special = s->prev.special;
+  td->curr.line_no = _RECORD_LINE(&s->prev);
+  td->curr.type = _RECORD_TYPE(&s->prev);
+  return 0;
+}
+
+#endif
+
+EMSCRIPTEN_KEEPALIVE
 int blep_token_next() {
   if (td->peek.p) {
     memcpy(&td->curr, &td->peek, sizeof(struct token));
@@ -586,7 +706,7 @@ int blep_token_next() {
     if (td->at >= td->end) {
       return 0;
     }
-    if (!td->depth || td->depth == STACK_SIZE) {
+    if (!td->depth || td->depth == td->stack_cap) {
       debugf("stack err: %c (depth=%d)\n", td->at[0], td->depth);
       return ERROR__STACK;
     }
@@ -597,6 +717,11 @@ int blep_token_next() {
   return td->curr.type;
 }
 
+EMSCRIPTEN_KEEPALIVE
+struct token *blep_token_cursor() {
+  return &(td->curr);
+}
+
 int blep_token_peek() {
   if (td->peek.p) {
     // we need to allow duplicate peeks for a few cases
@@ -14,18 +14,66 @@ struct token {
   uint32_t special;
 };
 
+// Compact pointer-free form of a token, with offsets from the start of input. This has the same
+// 16-byte layout on wasm and native builds, so arrays of it can be persisted or shared as-is.
+struct token_record {
+  uint32_t at;
+  uint32_t len;
+  uint32_t special;
+  uint32_t line_type;  // line_no << 5 | type
+};
+
+#define _RECORD_TYPE_BITS 5
+#define _RECORD_TYPE(r)   ((int) ((r)->line_type & ((1 << _RECORD_TYPE_BITS) - 1)))
+#define _RECORD_LINE(r)   ((int) ((r)->line_type >> _RECORD_TYPE_BITS))
+
 
 int blep_token_init(char *, int);
 int blep_token_update(int);
 int blep_token_next();
 int blep_token_peek();
+struct token *blep_token_cursor();  // the token from blep_token_next
 
 int blep_token_set_restore();
 int blep_token_restore();
 
+// Packs a token from the current input (since blep_token_init) into its compact form.
+void blep_token_record(struct token_record *, struct token *);
+
+// Tokenizes up to cap further tokens into records, without parsing, so `/` is classified by the
+// tokenizer's guess from the previous token. Returns the number written, which is less than cap
+// only at the end of input, or a negative ERROR__ value.
+int blep_token_records(struct token_record *, int cap);
+
 
 #define STACK_SIZE    256
 
+// Provides storage for the bracket stack once it's deeper than STACK_SIZE (e.g., generated data
+// modules with deeply nested arrays), which is otherwise an ERROR__STACK. The inline stack is copied
+// in when first needed. This is per-thread and kept across inits; pass NULL to remove it.
+void blep_token_arena(int *arena, int cap);
+
+// Pointer-free tokenizer state between tokens, so tokenizing can stop at the end of one buffer and
+// resume in another (e.g., as input arrives in chunks). Offsets are from the start of the input
+// passed to blep_token_init or blep_token_resume. The tokenizer looks back at the previous token to
+// guess regexps and newlines, so its bytes must be kept when resuming.
+//
+// Only the first STACK_SIZE entries of the stack are kept here. Any deeper are left in the arena,
+// which must be unchanged when resuming.
+struct token_snapshot {
+  uint32_t at;              // head
+  int line_no;              // line_no at head
+  struct token_record prev; // previous token
+  int depth;
+  int stack[STACK_SIZE];
+};
+
+// Captures the state after the last token. There must be no peek or restore pending.
+void blep_token_snapshot(struct token_snapshot *);
+
+// Resumes from a snapshot over new input of len bytes, where byte zero was at offset shift of the
+// snapshot's input. The previous token must still be present, i.e., shift <= prev.at.
+int blep_token_resume(char *, int, const struct token_snapshot *, uint32_t shift);
 
 
 typedef struct {
@@ -34,11 +82,14 @@ typedef struct {
 
   int line_no;  // line_no at head
   char *at;     // head pointer
-  char *end;    // end of input (must point to NULL)
+  char *start;  // start of input, which token records are relative to
+  char *end;    // end of input (need not point to NULL)
 
   // depth/stack at head (just used for balancing)
   int depth;
-  int stack[STACK_SIZE];
+  int *stack;      // stack_inline, or the arena once deeper than STACK_SIZE
+  int stack_cap;
+  int stack_inline[STACK_SIZE];
 
   struct token restore__curr;
   int restore__line_no;
@@ -46,11 +97,18 @@ typedef struct {
   int restore__depth;
 } tokendef;
 
-// global
+// global, but per-thread in native builds so that each thread can run its own parse
+// nb. BLEP_SINGLE_THREAD avoids thread-local access, which is slow in a dlopen()'ed library
+#if defined(EMSCRIPTEN) || defined(BLEP_SINGLE_THREAD)
+#define _THREAD_LOCAL
+#else
+#define _THREAD_LOCAL _Thread_local
+#endif
+
 #ifdef EMSCRIPTEN
 #define td ((tokendef *) 20)
 #else
-extern tokendef _td;
+extern _THREAD_LOCAL tokendef _td;
 #define td (&_td)
 #endif
 
@@ -85,6 +85,12 @@ void blep_parser_callback() {
     if (t->special & SPECIAL__DESTRUCTURING) {
       printf(" destructuring");
     }
+    if (t->special & SPECIAL__DYNAMIC) {
+      printf(" dynamic");
+    }
+    if (t->special & SPECIAL__META) {
+      printf(" meta");
+    }
   }
 
   printf("\n");
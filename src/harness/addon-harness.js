@@ -0,0 +1,125 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Harness backed by the optional native addon (see "src/addon"). The addon parses a
+ * whole range in one call, recording tokens and stacks into an array, which is then replayed into
+ * handlers.
+ */
+
+import * as blep from './types/index.js';
+import {noop, parseError} from './harness.js';
+import {buildReplay, EVENT_WORDS} from './replay.js';
+
+import {createRequire} from 'module';
+
+/**
+ * @typedef {{
+ *   run(source: Uint8Array, start: number, end: number, scan: boolean, events: Int32Array): {
+ *     ret: number,
+ *     events: Int32Array,
+ *     count: number,
+ *     at: number,
+ *     lineNo: number,
+ *   },
+ * }} Addon
+ */
+
+// Built by `make addon`, or node-gyp from within "src/addon".
+const addonPaths = ['../../_build/gumnut.node', '../addon/build/Release/gumnut.node'];
+
+/**
+ * Loads the native addon, if it has been built. Set `GUMNUT_WASM` in the environment to always
+ * use WASM instead.
+ *
+ * @return {Addon?}
+ */
+export function loadAddon() {
+  if (process.env['GUMNUT_WASM']) {
+    return null;
+  }
+  const require = createRequire(import.meta.url);
+  for (const p of addonPaths) {
+    try {
+      return require(p);
+    } catch (e) {
+      // not built here, try the next
+    }
+  }
+  return null;
+}
+
+/**
+ * @param {Addon} addon
+ * @return {blep.Harness}
+ */
+export default function build(addon) {
+  /** @type {blep.Handlers} */
+  let handlers = {callback: noop, open: noop, close: noop};
+  let source = new Uint8Array(0);
+
+  // The addon records into this, replacing it with a larger array if it doesn't fit.
+  let events = new Int32Array(EVENT_WORDS * 4096);
+
+  const {token, replay} = buildReplay(() => source);
+
+  return {
+    token,
+
+    prepare(size) {
+      source = new Uint8Array(size);
+      return source;
+    },
+
+    handle(update) {
+      handlers = {...handlers, ...update};
+    },
+
+    run(start = 0, end = source.length) {
+      return internalRun(false, start, end);
+    },
+
+    scan(start = 0, end = source.length) {
+      return internalRun(true, start, end);
+    },
+  };
+
+  /**
+   * @param {boolean} scan
+   * @param {number} start
+   * @param {number} end
+   * @return {number}
+   */
+  function internalRun(scan, start, end) {
+    if (start < 0 || end > source.length || start > end) {
+      throw new RangeError(`invalid range: ${start}-${end} of ${source.length}`);
+    }
+
+    const result = addon.run(source, start, end, scan, events);
+    const {ret, count, at, lineNo} = result;
+    events = result.events;
+
+    // reset handlers, but replay with the current ones
+    const current = handlers;
+    handlers = {callback: noop, open: noop, close: noop};
+    replay(events, count, current);
+
+    if (ret < 0) {
+      throw parseError(ret, source, at, lineNo, 0, end);
+    }
+    return ret;
+  }
+}
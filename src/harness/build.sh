@@ -1,18 +1,54 @@
 #!/bin/bash
 
+# Usage: build.sh [debug|release|check] [full|imports|lexer]
+#
+# The second argument picks which parts of the parser are included:
+#   full     the whole parser => runner.wasm
+#   imports  only blep_parser_scan, for module statements => runner-imports.wasm
+#   lexer    only the tokenizer (blep_token_next) => runner-lexer.wasm
+
 set -eu
 
 FLAGS="-O1 -g4"
+OUT=runner.wasm
+SOURCES="harness.c ../core/token.c ../core/parser.c"
 export EMCC_DEBUG=1
 if [[ "${1-}" == "release" ]]; then
   export EMCC_DEBUG=0
   FLAGS="-O2 -DSPEED"
   echo "Release mode (\"${FLAGS}\")" >&2
-elif [[ "${1-}" != "" ]]; then
+elif [[ "${1-}" == "check" ]]; then
+  # validation only: the parser calls no handlers, so this only reports success or failure
+  export EMCC_DEBUG=0
+  FLAGS="-O2 -DSPEED -DBLEP_VALIDATE"
+  OUT=check.wasm
+  echo "Check mode (\"${FLAGS}\")" >&2
+elif [[ "${1-}" != "" && "${1-}" != "debug" ]]; then
   echo "Unknown mode: $1" >&2
   exit 1
 fi
 
+case "${2-full}" in
+  full)
+    ;;
+  imports)
+    FLAGS="${FLAGS} -DBLEP_IMPORTS_ONLY"
+    OUT=runner-imports.wasm
+    ;;
+  lexer)
+    SOURCES="harness.c ../core/token.c"
+    OUT=runner-lexer.wasm
+    ;;
+  *)
+    echo "Unknown variant: $2" >&2
+    exit 1
+    ;;
+esac
+if [[ "${1-}" == "check" && "${OUT}" != "check.wasm" ]]; then
+  echo "Check mode is only built for the full parser" >&2
+  exit 1
+fi
+
 # With Homebrew on Mac as of 2020-06, this generates a warning like:
 #
 # > emcc: warning: the fastomp compiler is deprecated.  Please switch to the upstream llvm backend as soon as possible and open issues if you have trouble doing so [-Wfastcomp]
@@ -31,6 +67,11 @@ fi
 MEMORY=65536
 STACK=2048
 
+# STACK only holds locals whose address is taken: the parser recurses on the engine's own stack,
+# which is about 1MB in V8 and overflows at ~6k nested arrows. Cap nesting well inside that, so deep
+# input fails with ERROR__STACK rather than a RangeError (see PARSER_MAX_DEPTH).
+FLAGS="${FLAGS} -DPARSER_MAX_DEPTH=4096"
+
 emcc $FLAGS \
   -s SIDE_MODULE=2 \
   -s ALLOW_MEMORY_GROWTH=0 \
@@ -38,8 +79,8 @@ emcc $FLAGS \
   -s ERROR_ON_UNDEFINED_SYMBOLS=0 \
   -s INITIAL_MEMORY=${MEMORY} \
   -s TOTAL_STACK=${STACK} \
-  -o runner.wasm \
-  *.c ../core/*.c
+  -o ${OUT} \
+  ${SOURCES}
 
-chmod -x runner.wasm
-echo "Ok! => runner.wasm"
+chmod -x ${OUT}
+echo "Ok! => ${OUT}"
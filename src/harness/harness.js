@@ -24,6 +24,12 @@ const PAGE_SIZE = 65536;
 const WRITE_AT = PAGE_SIZE * 2;
 const ERROR_CONTEXT_MAX = 256;  // display this much text on either side
 const TOKEN_WORD_COUNT = 6;
+const RECORD_BATCH = 4096;  // records written by each call to the tokenizer
+
+/**
+ * Words per token in arrays from {@link blep.LexerHarness.tokens}, as `struct token_record`.
+ */
+export const RECORD_WORDS = 4;
 
 const safeEval = eval;  // try to avoid global side-effects with rename
 
@@ -75,10 +81,15 @@ async function initialize(modulePromise, imports) {
 }
 
 /**
+ * Builds a harness over any runner: the full parser, one with only `blep_parser_scan` (where `run`
+ * throws), or one with only the tokenizer (where `run` and `scan` announce raw tokens and no stacks).
+ * Pass `lexer` to use the tokenizer of a full runner, if it has one.
+ *
  * @param {Promise<BufferSource>|BufferSource} modulePromise
- * @return {Promise<blep.Harness>}
+ * @param {{lexer?: boolean}=} options
+ * @return {Promise<blep.LexerHarness>}
  */
-export default async function build(modulePromise) {
+export default async function build(modulePromise, {lexer = false} = {}) {
   let {callback, open, close} = defaultHandlers;
 
   // These views need to be mutable as they'll point to a new WebAssembly.Memory when it gets
@@ -93,6 +104,12 @@ export default async function build(modulePromise) {
       return s;
     },
 
+    memcpy(dest, src, n) {
+      // nb. runtime-sized copies (e.g., the tokenizer's tail near the end of input) import this
+      view.copyWithin(dest, src, src + n);
+      return dest;
+    },
+
     memchr(ptr, char, len) {
       const index = view.subarray(ptr, ptr + len).indexOf(char);
       if (index === -1) {
@@ -120,16 +137,39 @@ export default async function build(modulePromise) {
   const {
     blep_parser_init: parser_init,
     blep_parser_run: parser_run,
+    blep_parser_scan: parser_scan = parser_run,  // older runners don't have scan, parse it all
     blep_parser_cursor: parser_cursor,
+    blep_token_init: token_init,
+    blep_token_next: token_next,
+    blep_token_cursor: token_cursor,
+    blep_token_records: token_records,
   } = calls;
 
-  const tokenAt = parser_cursor();
+  // Older runners don't export the tokenizer, so their tokens come from a full parse instead.
+  /** @type {{init: (at: number, len: number) => number, step: () => number}?} */
+  let lex = null;
+  if (token_init && token_next && token_cursor && (lexer || parser_init === undefined)) {
+    const next = token_next;
+    lex = {
+      init: token_init,
+      step() {
+        const type = next();
+        if (type > 0) {
+          callback();
+        }
+        return type;
+      },
+    };
+  }
+
+  const tokenAt = lex && token_cursor ? token_cursor() : parser_cursor();
   if (tokenAt >= WRITE_AT) {
     throw new Error(`token in invalid location`);
   }
 
   let tokenView = new Int32Array(memory.buffer, tokenAt, TOKEN_WORD_COUNT);
   let inputSize = 0;
+  let recordsAt = 0;  // after input, if the runner can write records
 
   const token = /** @type {blep.Token} */ ({
     void() {
@@ -168,20 +208,7 @@ export default async function build(modulePromise) {
       if (tokenView[4] !== stringType) {
         throw new TypeError('Can\'t stringValue() on non-string');
       }
-      const target = view.subarray(tokenView[1], tokenView[1] + tokenView[2]);
-
-      switch (target[0]) {
-        case 96:
-          if (target[target.length - 1] == 96) {
-            break;
-          }
-          // fall-through
-
-        case 125:
-          throw new TypeError('Can\'t stringValue() on template string with holes');
-      }
-
-      return safeEval(decoder.decode(target));
+      return stringValue(view.subarray(tokenView[1], tokenView[1] + tokenView[2]));
     },
   });
 
@@ -193,7 +220,11 @@ export default async function build(modulePromise) {
      * @return {Uint8Array}
      */
     prepare(size) {
-      const memoryNeeded = WRITE_AT + size + 1;
+      let memoryNeeded = WRITE_AT + size + 1;
+      if (token_records) {
+        recordsAt = (memoryNeeded + 15) & ~15;
+        memoryNeeded = recordsAt + RECORD_WORDS * 4 * RECORD_BATCH;
+      }
       if (memory.buffer.byteLength < memoryNeeded) {
         memory.grow(Math.ceil((memoryNeeded - memory.buffer.byteLength) / PAGE_SIZE));
       }
@@ -213,38 +244,161 @@ export default async function build(modulePromise) {
       ({callback, open, close} = {callback, open, close, ...handlers});
     },
 
-    run() {
-      let statements = 0;
-      let ret = parser_init(WRITE_AT, inputSize);
+    run(start = 0, end = inputSize) {
+      if (lex) {
+        return internalRun(lex.init, lex.step, start, end) - 1;  // the last step finds the end
+      } else if (parser_run === undefined) {
+        throw new TypeError('this runner only supports scan()');
+      }
+      return internalRun(parser_init, parser_run, start, end);
+    },
+
+    scan(start = 0, end = inputSize) {
+      if (lex) {
+        return internalRun(lex.init, lex.step, start, end) - 1;
+      } else if (parser_scan === undefined) {
+        throw new TypeError('this runner has no parser');
+      }
+      return internalRun(parser_init, parser_scan, start, end);
+    },
+
+    tokens(start = 0, end = inputSize) {
+      if (!token_records || !token_init) {
+        // older runners can only announce tokens one at a time
+        if (parser_run === undefined) {
+          throw new TypeError('this runner only supports scan()');
+        }
+        /** @type {number[]} */
+        const out = [];
+        callback = () => {
+          out.push(tokenView[1] - WRITE_AT, tokenView[2], tokenView[5], (tokenView[3] << 5) | tokenView[4]);
+        };
+        internalRun(parser_init, parser_run, start, end);
+        return Uint32Array.from(out);
+      }
+
+      if (start < 0 || end > inputSize || start > end) {
+        throw new RangeError(`invalid range: ${start}-${end} of ${inputSize}`);
+      }
+
+      // guess at one token per four bytes, growing as needed
+      let out = new Uint32Array(RECORD_WORDS * Math.max(RECORD_BATCH, (end - start) >> 2));
+      let count = 0;
+      let ret = token_init(WRITE_AT + start, end - start);
+      while (ret >= 0) {
+        ret = token_records(recordsAt, RECORD_BATCH);
+        if (ret <= 0) {
+          break;
+        }
+
+        const words = RECORD_WORDS * ret;
+        if (out.length < RECORD_WORDS * count + words) {
+          const prev = out;
+          out = new Uint32Array(prev.length * 2);
+          out.set(prev);
+        }
+        out.set(new Uint32Array(memory.buffer, recordsAt, words), RECORD_WORDS * count);
+        count += ret;
+
+        if (ret < RECORD_BATCH) {
+          ret = 0;
+          break;
+        }
+      }
+      if (ret < 0) {
+        throw parseError(ret, view, tokenView[1], tokenView[3], WRITE_AT, WRITE_AT + end);
+      }
+
+      // records are relative to where the tokenizer started
+      if (start) {
+        for (let i = 0; i < count; ++i) {
+          out[RECORD_WORDS * i] += start;
+        }
+      }
+      return out.subarray(0, RECORD_WORDS * count);
+    },
+
+  };
+
+  /**
+   * @param {(at: number, len: number) => number} init
+   * @param {() => number} step
+   * @param {number} start
+   * @param {number} end
+   * @return {number}
+   */
+  function internalRun(init, step, start, end) {
+    if (start < 0 || end > inputSize || start > end) {
+      throw new RangeError(`invalid range: ${start}-${end} of ${inputSize}`);
+    }
+
+    // The parser needs its input to be null-terminated, so temporarily end the range in place.
+    const endAt = WRITE_AT + end;
+    const restore = view[endAt];
+    view[endAt] = 0;
+
+    let statements = 0;
+    let ret;
+    try {
+      ret = init(WRITE_AT + start, end - start);
       if (ret >= 0) {
         do {
-          ret = parser_run();
+          ret = step();
           ++statements;
         } while (ret > 0);
       }
+    } finally {
+      view[endAt] = restore;
+    }
 
-      // reset handlers
-      ({callback, open, close} = defaultHandlers);
+    // reset handlers
+    ({callback, open, close} = defaultHandlers);
 
-      if (ret === 0) {
-        return statements;
-      }
-      const at = tokenView[1];
-      const view = new Uint8Array(memory.buffer);
+    if (ret === 0) {
+      return statements;
+    }
+    throw parseError(ret, view, tokenView[1], tokenView[3], WRITE_AT, endAt);
+  }
+}
 
-      // Special-case crash on a NULL byte. There was no more input.
-      if (view[at] === 0) {
-        throw new TypeError(`Unexpected end of input`);
+/**
+ * @param {number} ret negative return code from the parser
+ * @param {Uint8Array} view
+ * @param {number} at of the failing token within view
+ * @param {number} lineNo of the failing token
+ * @param {number} writeAt start of source within view
+ * @param {number} endAt end of the parsed range within view
+ * @return {TypeError}
+ */
+export function parseError(ret, view, at, lineNo, writeAt, endAt) {
+  // Special-case crash on a NULL byte. There was no more input.
+  if (view[at] === 0 || at === endAt) {
+    return new TypeError(`Unexpected end of input`);
+  }
+
+  // Otherwise, generate a sane error.
+  const {line, pos, offset} = lineAround(view, at, writeAt);
+  const errorType = errorMap.get(ret) || `(? ${ret})`;
+  return new TypeError(`[${lineNo}:${pos}] ${errorType}:\n${line}\n${'^'.padStart(offset + 1)}`);
+}
+
+/**
+ * @param {Uint8Array} target bytes of a string token, including its quotes
+ * @return {string}
+ */
+export function stringValue(target) {
+  switch (target[0]) {
+    case 96:
+      if (target[target.length - 1] == 96) {
+        break;
       }
+      // fall-through
 
-      // Otherwise, generate a sane error.
-      const lineNo = tokenView[3];
-      const {line, pos, offset} = lineAround(view, at, WRITE_AT);
-      const errorType = errorMap.get(ret) || `(? ${ret})`;
-      throw new TypeError(`[${lineNo}:${pos}] ${errorType}:\n${line}\n${'^'.padStart(offset + 1)}`);
-    },
+    case 125:
+      throw new TypeError('Can\'t stringValue() on template string with holes');
+  }
 
-  };
+  return safeEval(decoder.decode(target));
 }
 
 /**
@@ -0,0 +1,182 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Finds inline module scripts in HTML. Does not use Node-specific APIs.
+ *
+ * This is not a HTML parser: it only understands enough (comments, tags and their attributes) to
+ * find the byte range of each `<script type="module">` without allocating per-tag strings.
+ */
+
+const decoder = new TextDecoder('utf-8');
+
+const LT = 60;      // <
+const GT = 62;      // >
+const SLASH = 47;   // /
+const EQUALS = 61;  // =
+const BANG = 33;    // !
+const DASH = 45;    // -
+const DQUOTE = 34;  // "
+const SQUOTE = 39;  // '
+
+/**
+ * @param {number} c
+ * @return {boolean}
+ */
+const isSpace = (c) => c === 32 || (c >= 9 && c <= 13);
+
+/**
+ * @param {number} c
+ * @return {number} the ASCII character lowercased
+ */
+const lower = (c) => (c >= 65 && c <= 90) ? c + 32 : c;
+
+/**
+ * @param {Uint8Array} view
+ * @param {number} at
+ * @param {string} s lowercase string to match
+ * @return {boolean}
+ */
+function matchesAt(view, at, s) {
+  if (at + s.length > view.length) {
+    return false;
+  }
+  for (let i = 0; i < s.length; ++i) {
+    if (lower(view[at + i]) !== s.charCodeAt(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @param {Uint8Array} view
+ * @param {number} at
+ * @param {string} s lowercase string to find, case-insensitive
+ * @return {number} index of the string, or -1
+ */
+function indexOfLower(view, at, s) {
+  const first = s.charCodeAt(0);
+  const upper = (first >= 97 && first <= 122) ? first - 32 : first;
+  for (;;) {
+    // indexOf is fast, so check both cases of the first character
+    const a = view.indexOf(first, at);
+    const b = upper === first ? -1 : view.indexOf(upper, at);
+    at = (a === -1 || (b !== -1 && b < a)) ? b : a;
+    if (at === -1 || matchesAt(view, at, s)) {
+      return at;
+    }
+    ++at;
+  }
+}
+
+/**
+ * Finds the byte ranges of the contents of inline module scripts in the passed HTML.
+ *
+ * @param {Uint8Array} view
+ * @return {{start: number, end: number}[]}
+ */
+export function findModuleScripts(view) {
+  /** @type {{start: number, end: number}[]} */
+  const out = [];
+  let at = 0;
+
+  for (;;) {
+    at = view.indexOf(LT, at);
+    if (at === -1) {
+      break;
+    }
+
+    if (view[at + 1] === BANG && view[at + 2] === DASH && view[at + 3] === DASH) {
+      const end = indexOfLower(view, at + 4, '-->');
+      if (end === -1) {
+        break;
+      }
+      at = end + 3;
+      continue;
+    }
+
+    ++at;
+    if (!matchesAt(view, at, 'script')) {
+      continue;
+    }
+    at += 6;
+    if (at < view.length && !isSpace(view[at]) && view[at] !== GT && view[at] !== SLASH) {
+      continue;  // e.g., <scripts>
+    }
+
+    // Read attributes until '>', noting "type" and "src".
+    let type = '';
+    let hasSrc = false;
+    while (at < view.length && view[at] !== GT) {
+      if (isSpace(view[at]) || view[at] === SLASH) {
+        ++at;
+        continue;
+      }
+
+      const nameAt = at;
+      while (at < view.length && !isSpace(view[at]) && view[at] !== EQUALS && view[at] !== GT && view[at] !== SLASH) {
+        ++at;
+      }
+      const isType = at - nameAt === 4 && matchesAt(view, nameAt, 'type');
+      hasSrc = hasSrc || (at - nameAt === 3 && matchesAt(view, nameAt, 'src'));
+
+      while (at < view.length && isSpace(view[at])) {
+        ++at;
+      }
+      if (view[at] !== EQUALS) {
+        continue;  // attribute without value
+      }
+      ++at;
+      while (at < view.length && isSpace(view[at])) {
+        ++at;
+      }
+
+      let valueAt = at;
+      let valueEnd;
+      if (view[at] === DQUOTE || view[at] === SQUOTE) {
+        ++valueAt;
+        valueEnd = view.indexOf(view[at], valueAt);
+        if (valueEnd === -1) {
+          valueEnd = view.length;
+        }
+        at = valueEnd + 1;
+      } else {
+        while (at < view.length && !isSpace(view[at]) && view[at] !== GT) {
+          ++at;
+        }
+        valueEnd = at;
+      }
+
+      if (isType) {
+        type = decoder.decode(view.subarray(valueAt, valueEnd)).trim().toLowerCase();
+      }
+    }
+
+    const start = at + 1;
+    const end = indexOfLower(view, start, '</script');
+    if (end === -1 || start > view.length) {
+      break;  // unterminated, browsers ignore this
+    }
+    at = end + 8;
+
+    if (type === 'module' && !hasSrc) {
+      out.push({start, end});
+    }
+  }
+
+  return out;
+}
@@ -15,8 +15,9 @@
  */
 
 /**
- * @fileoverview Node wrapper for Blep. Uses Node's fs package to load the runner wasm and return
- * a blep.Harness.
+ * @fileoverview Node wrapper for Blep. Uses the native addon if it has been built, otherwise uses
+ * Node's fs package to load the runner wasm and return a blep.Harness. This may be wrapped in a
+ * persistent parse cache (see "parse-cache.js").
  */
 
 import * as blep from './types/index.js';
@@ -24,12 +25,77 @@ import * as blep from './types/index.js';
 export * from './harness.js';
 import build from './harness.js';
 
+import buildAddon, {loadAddon} from './addon-harness.js';
+import buildCachedHarness from './parse-cache.js';
+
+import * as crypto from 'crypto';
 import * as fs from 'fs';
 
 /**
+ * @typedef {'full'|'imports'|'lexer'} RunnerVariant
+ */
+
+/** @type {{[variant in RunnerVariant]: string}} */
+const runnerFiles = {
+  full: 'runner.wasm',
+  imports: 'runner-imports.wasm',
+  lexer: 'runner-lexer.wasm',
+};
+
+/**
+ * Builds a harness. If a cache directory is passed, or set as `GUMNUT_CACHE_DIR` in the
+ * environment, parses are shared through it with other processes.
+ *
+ * Pass `runner` to load a smaller WASM runner with only part of the parser (see "build.sh"). The
+ * native addon is still used for "imports", as it has no load cost, but never for "lexer".
+ *
+ * @param {{cacheDir?: string, cacheMaxBytes?: number, runner?: RunnerVariant}=} options
  * @return {!Promise<blep.Harness>}
  */
-export default async function wrapper() {
-  const {pathname} = new URL('./runner.wasm', import.meta.url);
-  return build(fs.readFileSync(pathname));
+export default async function wrapper({
+  cacheDir = process.env['GUMNUT_CACHE_DIR'],
+  cacheMaxBytes,
+  runner = 'full',
+} = {}) {
+  const {harness, backend} = await buildUncached(runner);
+  if (cacheDir && runner !== 'lexer') {
+    return buildCachedHarness(harness, {dir: cacheDir, maxBytes: cacheMaxBytes, backend});
+  }
+  return harness;
+}
+
+/**
+ * Reads the WASM for a runner variant. Falls back to the full "runner.wasm" if the variant hasn't
+ * been built, as it supports everything the others do.
+ *
+ * @param {RunnerVariant} runner
+ * @return {Buffer}
+ */
+export function readRunner(runner) {
+  const {pathname} = new URL(`./${runnerFiles[runner]}`, import.meta.url);
+  try {
+    return fs.readFileSync(pathname);
+  } catch (e) {
+    if (runner === 'full') {
+      throw e;
+    }
+  }
+  return readRunner('full');
+}
+
+/**
+ * Builds a harness without a cache, plus a name for its backend. WASM runners are named by a hash
+ * of their bytes, as a rebuilt runner may not tokenize the same as the addon or an older build.
+ *
+ * @param {RunnerVariant} runner
+ * @return {!Promise<{harness: blep.Harness, backend: string}>}
+ */
+async function buildUncached(runner = 'full') {
+  const addon = runner !== 'lexer' && loadAddon();
+  if (addon) {
+    return {harness: await buildAddon(addon), backend: 'addon'};
+  }
+  const wasm = readRunner(runner);
+  const hash = crypto.createHash('sha256').update(wasm).digest('hex').slice(0, 16);
+  return {harness: await build(wasm, {lexer: runner === 'lexer'}), backend: `wasm-${hash}`};
 }
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Node entrypoint for the imports-only runner, "runner-imports.wasm", which only
+ * supports `scan`. Uses the native addon if it has been built, like the full harness.
+ */
+
+import * as blep from './types/index.js';
+import buildHarness from './node-harness.js';
+
+/**
+ * Builds a harness which supports `scan` only. Options are as for the full harness.
+ *
+ * @param {{cacheDir?: string, cacheMaxBytes?: number}=} options
+ * @return {!Promise<blep.Harness>}
+ */
+export default function buildImportsHarness(options = {}) {
+  return buildHarness({...options, runner: 'imports'});
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Node entrypoint for the lexer-only runner, "runner-lexer.wasm", which contains just
+ * the tokenizer. Its harness announces every token without parsing, for tools which don't need
+ * grammar-driven classification (e.g., highlighting or counting tokens), and can write all tokens
+ * into a typed array with `tokens()`.
+ */
+
+import * as blep from './types/index.js';
+import build from './harness.js';
+import {readRunner} from './node-harness.js';
+
+export {RECORD_WORDS} from './harness.js';
+
+/**
+ * Builds a harness whose `run` and `scan` only tokenize.
+ *
+ * @return {!Promise<blep.LexerHarness>}
+ */
+export default function buildLexer() {
+  return build(readRunner('lexer'), {lexer: true});
+}
@@ -24,6 +24,7 @@
 import * as blep from './types/index.js';
 import * as fs from 'fs';
 import {noop} from './harness.js';
+import {findModuleScripts} from './html.js';
 
 
 const PENDING_BUFFER_MAX = 1024 * 16;
@@ -35,13 +36,13 @@ const encoder = new TextEncoder();
  * @return {blep.RewriterReturn}
  */
 export default function wrapper(harness) {
-  const {prepare, token, run: internalRun, handle} = harness;
+  const {prepare, token, run: internalRun, scan: internalScan, handle} = harness;
 
   /**
    * @param {string} f
    * @param {Partial<blep.RewriterArgs>} args
    */
-  const run = (f, {callback = noop, stack = noop, write = noop}) => {
+  const run = (f, {callback = noop, stack = noop, close = noop, write = noop, scan = false, html = /\.html?$/i.test(f)}) => {
     const fd = fs.openSync(f, 'r');
     /** @type {Uint8Array} */
     let buffer;
@@ -58,10 +59,29 @@ export default function wrapper(harness) {
     }
 
     let sent = 0;
+    let lastEnd = 0;  // end of the last non-empty token
+
+    /**
+     * @param {Uint8Array|string} update
+     */
+    const writeUpdate = (update) => {
+      if (update.length) {
+        if (typeof update === 'string') {
+          write(encoder.encode(update));
+        } else {
+          write(update);
+        }
+      }
+    };
 
-    handle({
+    /** @type {blep.Handlers} */
+    const handlers = {
       callback() {
         const p = token.at();
+        const length = token.length();
+        if (length) {
+          lastEnd = p + length;
+        }
 
         const update = callback();
         if (update === undefined) {
@@ -78,17 +98,10 @@ export default function wrapper(harness) {
           write(buffer.subarray(sent, p));
         }
 
-        // write update
-        if (update.length) {
-          if (typeof update === 'string') {
-            write(encoder.encode(update));
-          } else {
-            write(update);
-          }
-        }
+        writeUpdate(update);
 
         // move past the "original" string
-        sent = p + token.length();
+        sent = p + length;
       },
 
       open: stack,
@@ -96,10 +109,27 @@ export default function wrapper(harness) {
       close(type) {
         // nb. we're passed the type being closed
         stack(0);
+
+        const update = close();
+        if (update === undefined) {
+          return;
+        }
+
+        // insert directly after the last token, before any trailing void
+        if (sent < lastEnd) {
+          write(buffer.subarray(sent, lastEnd));
+          sent = lastEnd;
+        }
+        writeUpdate(update);
       },
-    });
+    };
 
-    internalRun();
+    // HTML is parsed in place, one inline script at a time, so output is written in one pass.
+    const ranges = html ? findModuleScripts(buffer) : [{start: 0, end: buffer.length}];
+    for (const {start, end} of ranges) {
+      handle(handlers);  // cleared after every run
+      scan ? internalScan(start, end) : internalRun(start, end);
+    }
     if (sent !== buffer.length) {
       write(buffer.subarray(sent, buffer.length));
     }
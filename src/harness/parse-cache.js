@@ -0,0 +1,485 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Wraps a harness with a cache directory of parse results, which can be shared by
+ * many processes. Entries are keyed by a hash of the source, the mode (run or scan), the backend
+ * and the gumnut version. They hold the recorded events in the token stream format of
+ * "src/lib/stream.h" (see "stream.js"), so are readable by `gumnut_stream_open()` too.
+ *
+ * Entries are written to a temporary file and renamed into place, so readers never need to lock
+ * and never see a partial entry. Hits touch the entry's mtime (at most hourly), and writers
+ * occasionally evict the least recently used entries to keep the directory under `maxBytes`.
+ */
+
+import * as blep from './types/index.js';
+import * as common from './common.js';
+import {noop} from './harness.js';
+import {buildReplay, EVENT_WORDS, EVENT_OPEN, EVENT_CLOSE} from './replay.js';
+import {encodeStream, decodeStream} from './stream.js';
+
+import * as crypto from 'crypto';
+import * as fs from 'fs';
+import * as path from 'path';
+import {threadId} from 'worker_threads';
+
+const DEFAULT_MAX_BYTES = 256 * 1024 * 1024;
+const TOUCH_AFTER_MS = 60 * 60 * 1000;
+const STALE_TEMP_MS = 60 * 60 * 1000;
+
+// Entries from other versions are never read, as the parser's output may have changed.
+const {version} = JSON.parse(fs.readFileSync(new URL('../../package.json', import.meta.url), 'utf-8'));
+
+/**
+ * @typedef {{
+ *   imports: string[],
+ *   exports: string[],
+ * }} ModuleSummary
+ *
+ * @typedef {{
+ *   ret: number,
+ *   events: Int32Array,
+ *   count: number,
+ * }} CacheEntry
+ */
+
+/**
+ * Builds handlers which find the import specifiers and exported names of a run or scan, filling
+ * the returned summary. Imports are every external string, including dynamic imports with a static
+ * specifier.
+ *
+ * @param {blep.Token} token
+ * @return {{handlers: blep.Handlers, summary: ModuleSummary}}
+ */
+export function buildSummary(token) {
+  /** @type {ModuleSummary} */
+  const summary = {imports: [], exports: []};
+
+  /** @type {{type: number, index: number, exporting: boolean}[]} */
+  const stack = [];
+  let exportDepth = 0;
+
+  /** @type {string?} */
+  let pending = null;
+  const flush = () => {
+    if (pending !== null) {
+      summary.exports.push(pending);
+      pending = null;
+    }
+  };
+
+  /** @type {blep.Handlers} */
+  const handlers = {
+    open(type) {
+      stack.push({type, index: 0, exporting: false});
+      if (type === common.stacks.export) {
+        ++exportDepth;
+      }
+    },
+
+    close(type) {
+      const top = stack.pop();
+      if (top?.exporting) {
+        flush();
+      }
+      if (type === common.stacks.export) {
+        --exportDepth;
+      }
+    },
+
+    callback() {
+      const type = token.type();
+      const special = token.special();
+
+      if (type === common.types.string && special & common.specials.external) {
+        try {
+          summary.imports.push(token.stringValue());
+        } catch (e) {
+          // template with holes
+        }
+        return;
+      }
+
+      const top = stack[stack.length - 1];
+      if (!top) {
+        return;
+      }
+      const index = top.index++;
+      if (index === 0 && (top.type === common.stacks.export || top.type === common.stacks.module)) {
+        top.exporting = (special === common.lit.EXPORT);
+        return;
+      }
+
+      // export var x, function f() {}, default ...
+      if (exportDepth) {
+        if (type === common.types.symbol && (special & common.specials.declare) && (special & common.specials.external)) {
+          summary.exports.push(token.string());
+        } else if (index === 1 && top.exporting && special === common.lit.DEFAULT) {
+          summary.exports.push('default');
+        }
+        return;
+      }
+
+      // export {a as b}, export * as ns from ...
+      if (!top.exporting) {
+        return;
+      }
+      switch (type) {
+        case common.types.lit:
+        case common.types.symbol:
+          if (special & common.specials.external) {
+            pending = token.string();
+          }
+          break;
+
+        case common.types.op:
+          if (special === common.lit.$STAR) {
+            pending = '*';
+          } else if (special === common.lit.$COMMA) {
+            flush();
+          }
+          break;
+
+        case common.types.close:
+          flush();
+          break;
+
+        case common.types.keyword:
+          if (special === common.lit.FROM) {
+            flush();
+          }
+          break;
+      }
+    },
+  };
+
+  return {handlers, summary};
+}
+
+/**
+ * Finds the import specifiers and exported names of recorded events.
+ *
+ * @param {Int32Array} events
+ * @param {number} count
+ * @param {Uint8Array} view
+ * @return {ModuleSummary}
+ */
+export function summarize(events, count, view) {
+  const {token, replay} = buildReplay(() => view);
+  const {handlers, summary} = buildSummary(token);
+  replay(events, count, handlers);
+  return summary;
+}
+
+/**
+ * Moves token offsets of recorded events by a delta, leaving stack events alone.
+ *
+ * @param {Int32Array} events
+ * @param {number} count
+ * @param {number} delta
+ */
+function rebase(events, count, delta) {
+  const end = count * EVENT_WORDS;
+  for (let at = 0; at < end; at += EVENT_WORDS) {
+    if (events[at] >= 0) {
+      events[at] += delta;
+      events[at + 1] += delta;
+    }
+  }
+}
+
+/**
+ * Wraps a harness so that `run` and `scan` are served from a cache directory when the same source
+ * has been parsed before, by this or any other process. Handlers see the same tokens and stacks
+ * either way. Parse errors are not cached, so sources with errors are always parsed again.
+ *
+ * Pass `backend` to name what parses on a miss, e.g. the addon or a particular WASM runner. Their
+ * tokens can differ, so each backend only reads its own entries.
+ *
+ * @param {blep.Harness} harness
+ * @param {{dir: string, maxBytes?: number, backend?: string}} options
+ * @return {blep.Harness & {
+ *   summary(): ModuleSummary,
+ *   stats(): {hits: number, misses: number, evicted: number},
+ * }}
+ */
+export default function buildCachedHarness(harness, {dir, maxBytes = DEFAULT_MAX_BYTES, backend = ''}) {
+  fs.mkdirSync(dir, {recursive: true});
+
+  /** @type {blep.Handlers} */
+  let handlers = {callback: noop, open: noop, close: noop};
+  let source = new Uint8Array(0);
+
+  // The summary of the last run or scan, which is found from its entry only when asked for (or
+  // before the source is prepared again), as streams don't hold it.
+  /** @type {ModuleSummary} */
+  let lastSummary = {imports: [], exports: []};
+  /** @type {CacheEntry?} */
+  let lastEntry = null;
+
+  const resolveSummary = () => {
+    if (lastEntry) {
+      lastSummary = summarize(lastEntry.events, lastEntry.count, source);
+      lastEntry = null;
+    }
+    return lastSummary;
+  };
+
+  const stats = {hits: 0, misses: 0, evicted: 0};
+
+  // bytes written since the directory was last checked, which starts off as "too many"
+  let written = Infinity;
+
+  const {token, replay} = buildReplay(() => source);
+
+  /**
+   * @param {string} key
+   * @return {string}
+   */
+  const entryPath = (key) => path.join(dir, key.substr(0, 2), key.substr(2));
+
+  /**
+   * @param {string} key
+   * @param {number} length of the source, which the entry must match
+   * @return {CacheEntry?}
+   */
+  const read = (key, length) => {
+    let fd;
+    try {
+      fd = fs.openSync(entryPath(key), 'r');
+    } catch (e) {
+      return null;
+    }
+    try {
+      const stat = fs.fstatSync(fd);
+      const data = new Uint8Array(stat.size);
+      if (fs.readSync(fd, data, 0, stat.size, 0) !== stat.size) {
+        return null;
+      }
+      if (Date.now() - stat.mtimeMs > TOUCH_AFTER_MS) {
+        const now = new Date();
+        fs.futimesSync(fd, now, now);
+      }
+      const entry = decodeStream(data);
+      return entry?.sourceLength === length ? entry : null;
+    } catch (e) {
+      return null;
+    } finally {
+      fs.closeSync(fd);
+    }
+  };
+
+  /**
+   * @param {string} key
+   * @param {Uint8Array} data
+   */
+  const write = (key, data) => {
+    const target = entryPath(key);
+    // worker_threads share a pid, so include the thread too
+    const temp = `${target}.${process.pid}.${threadId}.tmp`;
+    try {
+      fs.mkdirSync(path.dirname(target), {recursive: true});
+      fs.writeFileSync(temp, data);
+      fs.renameSync(temp, target);
+    } catch (e) {
+      // another process may have evicted our directory, so just skip this entry
+      try {
+        fs.unlinkSync(temp);
+      } catch (e) {
+        // ignore
+      }
+      return;
+    }
+
+    written += data.length;
+    if (written > maxBytes / 8) {
+      evict();
+    }
+  };
+
+  /**
+   * Removes the least recently used entries (and abandoned temporary files) until the directory
+   * is under three quarters of `maxBytes`. Entries may be removed concurrently by other processes.
+   */
+  const evict = () => {
+    written = 0;
+
+    /** @type {{file: string, size: number, mtimeMs: number}[]} */
+    const all = [];
+    let total = 0;
+    const now = Date.now();
+
+    for (const sub of fs.readdirSync(dir)) {
+      let names;
+      try {
+        names = fs.readdirSync(path.join(dir, sub));
+      } catch (e) {
+        continue;
+      }
+      for (const name of names) {
+        const file = path.join(dir, sub, name);
+        try {
+          const {size, mtimeMs} = fs.statSync(file);
+          if (name.endsWith('.tmp')) {
+            if (now - mtimeMs > STALE_TEMP_MS) {
+              fs.unlinkSync(file);
+            }
+            continue;
+          }
+          all.push({file, size, mtimeMs});
+          total += size;
+        } catch (e) {
+          // removed by another process
+        }
+      }
+    }
+
+    if (total <= maxBytes) {
+      return;
+    }
+    all.sort((a, b) => a.mtimeMs - b.mtimeMs);
+    for (const {file, size} of all) {
+      if (total <= maxBytes * 0.75) {
+        break;
+      }
+      try {
+        fs.unlinkSync(file);
+        ++stats.evicted;
+      } catch (e) {
+        // removed by another process
+      }
+      total -= size;
+    }
+  };
+
+  /**
+   * Parses via the wrapped harness, recording every token and stack.
+   *
+   * @param {boolean} scan
+   * @param {number} start
+   * @param {number} end
+   * @return {CacheEntry}
+   */
+  const record = (scan, start, end) => {
+    let events = new Int32Array(EVENT_WORDS * 1024);
+    let count = 0;
+
+    const next = () => {
+      if ((count + 1) * EVENT_WORDS > events.length) {
+        const prev = events;
+        events = new Int32Array(prev.length * 2);
+        events.set(prev);
+      }
+      return EVENT_WORDS * count++;
+    };
+
+    harness.handle({
+      callback() {
+        const at = next();
+        events[at] = harness.token.void();
+        events[at + 1] = harness.token.at();
+        events[at + 2] = harness.token.length();
+        events[at + 3] = harness.token.lineNo();
+        events[at + 4] = harness.token.type();
+        events[at + 5] = harness.token.special();
+      },
+      open(type) {
+        const at = next();
+        events.fill(0, at, at + EVENT_WORDS);
+        events[at] = EVENT_OPEN;
+        events[at + 1] = type;
+      },
+      close(type) {
+        const at = next();
+        events.fill(0, at, at + EVENT_WORDS);
+        events[at] = EVENT_CLOSE;
+        events[at + 1] = type;
+      },
+    });
+
+    const ret = scan ? harness.scan(start, end) : harness.run(start, end);
+    return {ret, events, count};
+  };
+
+  /**
+   * @param {boolean} scan
+   * @param {number} start
+   * @param {number} end
+   * @return {number}
+   */
+  const internalRun = (scan, start, end) => {
+    // reset handlers, but replay with the current ones
+    const current = handlers;
+    handlers = {callback: noop, open: noop, close: noop};
+
+    const view = source.subarray(start, end);
+    const key = crypto.createHash('sha256')
+        .update(`${version}\0${backend}\0${scan ? 'scan' : 'run'}\0`)
+        .update(view)
+        .digest('hex');
+
+    let entry = read(key, view.length);
+    if (entry) {
+      ++stats.hits;
+      rebase(entry.events, entry.count, start);
+    } else {
+      ++stats.misses;
+      entry = record(scan, start, end);  // throws on parse error, caching nothing
+
+      // store offsets relative to the range, so the same source elsewhere also matches
+      rebase(entry.events, entry.count, -start);
+      write(key, encodeStream(entry.events, entry.count, view, {ret: entry.ret, scan}));
+      rebase(entry.events, entry.count, start);
+    }
+
+    lastEntry = entry;
+    replay(entry.events, entry.count, current);
+    return entry.ret;
+  };
+
+  return {
+    token,
+
+    prepare(size) {
+      resolveSummary();
+      source = harness.prepare(size);
+      return source;
+    },
+
+    handle(update) {
+      handlers = {...handlers, ...update};
+    },
+
+    run(start = 0, end = source.length) {
+      return internalRun(false, start, end);
+    },
+
+    scan(start = 0, end = source.length) {
+      return internalRun(true, start, end);
+    },
+
+    /**
+     * Returns the import specifiers and exported names found by the last run or scan.
+     */
+    summary() {
+      return resolveSummary();
+    },
+
+    stats() {
+      return {...stats};
+    },
+  };
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Replays parser events which were recorded into arrays (e.g., by the native addon)
+ * into handlers, via the same {@link blep.Token} interface as the WASM harness. Does not use
+ * Node-specific APIs.
+ *
+ * Each event is `EVENT_WORDS` 32-bit words. Tokens match `struct token`, but with offsets into the
+ * source rather than pointers: void, at, length, lineNo, type, special. Stacks instead have
+ * `EVENT_OPEN` or `EVENT_CLOSE` in place of void, followed by their type.
+ */
+
+import * as blep from './types/index.js';
+import {noop, stringValue} from './harness.js';
+import {string as stringType} from './types/v-types.js';
+
+export const EVENT_WORDS = 6;
+export const EVENT_OPEN = -1;
+export const EVENT_CLOSE = -2;
+
+const decoder = new TextDecoder('utf-8');
+
+/**
+ * @param {() => Uint8Array} getView returns the source that offsets refer to
+ * @return {{
+ *   token: blep.Token,
+ *   replay: (events: Int32Array, count: number, handlers: blep.Handlers) => void,
+ * }}
+ */
+export function buildReplay(getView) {
+  let events = new Int32Array(0);
+  let at = 0;
+
+  const token = /** @type {blep.Token} */ ({
+    void() {
+      return events[at];
+    },
+
+    at() {
+      return events[at + 1];
+    },
+
+    length() {
+      return events[at + 2];
+    },
+
+    lineNo() {
+      return events[at + 3];
+    },
+
+    type() {
+      return events[at + 4];
+    },
+
+    special() {
+      return events[at + 5];
+    },
+
+    view() {
+      return getView().subarray(events[at + 1], events[at + 1] + events[at + 2]);
+    },
+
+    string() {
+      return decoder.decode(token.view());
+    },
+
+    stringValue() {
+      if (events[at + 4] !== stringType) {
+        throw new TypeError('Can\'t stringValue() on non-string');
+      }
+      return stringValue(token.view());
+    },
+  });
+
+  return {
+    token,
+
+    replay(replayEvents, count, {callback = noop, open = noop, close = noop}) {
+      events = replayEvents;
+
+      // Like the parser, a stack whose open handler returns false is skipped: none of its tokens
+      // or inner stacks are announced, nor is its own close.
+      let skipDepth = 0;
+      const end = count * EVENT_WORDS;
+
+      for (at = 0; at < end; at += EVENT_WORDS) {
+        switch (events[at]) {
+          case EVENT_OPEN:
+            if (skipDepth) {
+              ++skipDepth;
+            } else if (open(events[at + 1]) === false) {
+              skipDepth = 1;
+            }
+            continue;
+
+          case EVENT_CLOSE:
+            if (skipDepth) {
+              --skipDepth;
+            } else {
+              close(events[at + 1]);
+            }
+            continue;
+        }
+
+        if (!skipDepth) {
+          callback();
+        }
+      }
+    },
+  };
+}
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Reads and writes the binary token stream format of "src/lib/stream.h" from events
+ * recorded for "replay.js", so streams written here can be read by `gumnut_stream_open()` and vice
+ * versa. This works with any backend, including WASM runners, which can't use the C writer. Does
+ * not use Node-specific APIs.
+ */
+
+import {EVENT_WORDS, EVENT_OPEN, EVENT_CLOSE} from './replay.js';
+
+// must match "src/lib/stream.h" and "src/lib/stream.c"
+export const STREAM_VERSION = 1;
+export const STREAM_HEADER = 40;
+export const STREAM_SCAN = 1;
+
+const MAGIC = 0x544e4d47;  // "GMNT"
+
+const KIND_TOKEN = 0;
+const KIND_OPEN = 1;
+const KIND_CLOSE = 2;
+
+const TOKEN_HAS_LINE = 4;
+const TOKEN_HAS_SPECIAL = 8;
+const TOKEN_SEEN_SPECIAL = 16;
+const TOKEN_TYPE_SHIFT = 5;
+
+const SEEN_BITS = 6;
+
+/**
+ * @param {number} special
+ * @return {number}
+ */
+const seenSlot = (special) => Math.imul(special, 0x9e3779b1) >>> (32 - SEEN_BITS);
+
+/**
+ * @typedef {{
+ *   flags: number,
+ *   sourceLength: number,
+ *   ret: number,
+ *   errorAt: number,
+ *   errorLine: number,
+ *   events: Int32Array,
+ *   count: number,
+ * }} DecodedStream
+ */
+
+/**
+ * FNV-1a (64-bit) of the source, as `gumnut_hash()`, in 32-bit halves.
+ *
+ * @param {Uint8Array} source
+ * @return {[number, number]} low and high words
+ */
+export function streamHash(source) {
+  let lo = 0x84222325;
+  let hi = 0xcbf29ce4;
+  for (let i = 0; i < source.length; ++i) {
+    lo ^= source[i];
+
+    // multiply by 2^40 + 0x1b3, keeping every intermediate within a double's exact range
+    const t = (lo >>> 0) * 0x1b3;
+    const nextLo = t >>> 0;
+    hi = (hi * 0x1b3 + (t - nextLo) / 0x100000000 + (lo & 0xffffff) * 0x100) >>> 0;
+    lo = nextLo;
+  }
+  return [lo >>> 0, hi];
+}
+
+/**
+ * Encodes recorded events as a stream. Token offsets must be relative to the start of source.
+ *
+ * @param {Int32Array} events
+ * @param {number} count
+ * @param {Uint8Array} source
+ * @param {{ret: number, scan: boolean, errorAt?: number, errorLine?: number}} result
+ * @return {Uint8Array}
+ */
+export function encodeStream(events, count, source, {ret, scan, errorAt = 0, errorLine = 0}) {
+  // each event is at most six 5-byte varints
+  const out = new Uint8Array(STREAM_HEADER + count * 30);
+  let len = STREAM_HEADER;
+
+  /** @param {number} v */
+  const putVarint = (v) => {
+    v >>>= 0;
+    while (v >= 0x80) {
+      out[len++] = (v & 0x7f) | 0x80;
+      v >>>= 7;
+    }
+    out[len++] = v;
+  };
+
+  const seen = new Int32Array(1 << SEEN_BITS);
+  let prevEnd = 0;
+  let prevLine = 1;
+
+  for (let at = 0; at < count * EVENT_WORDS; at += EVENT_WORDS) {
+    const vp = events[at];
+    if (vp === EVENT_OPEN || vp === EVENT_CLOSE) {
+      putVarint((events[at + 1] << 2) | (vp === EVENT_OPEN ? KIND_OPEN : KIND_CLOSE));
+      continue;
+    }
+
+    const p = events[at + 1];
+    const length = events[at + 2];
+    const lineNo = events[at + 3];
+    const special = events[at + 5];
+    const slot = seenSlot(special);
+
+    let head = (events[at + 4] << TOKEN_TYPE_SHIFT) | KIND_TOKEN;
+    if (!special) {
+      // nothing to write
+    } else if (seen[slot] === special) {
+      head |= TOKEN_SEEN_SPECIAL;
+    } else {
+      head |= TOKEN_HAS_SPECIAL;
+      seen[slot] = special;
+    }
+    if (lineNo !== prevLine) {
+      head |= TOKEN_HAS_LINE;
+    }
+
+    const delta = vp - prevEnd;
+    putVarint(head);
+    putVarint((delta << 1) ^ (delta >> 31));
+    putVarint(p - vp);
+    putVarint(length);
+    if (head & TOKEN_HAS_LINE) {
+      const lineDelta = lineNo - prevLine;
+      putVarint((lineDelta << 1) ^ (lineDelta >> 31));
+      prevLine = lineNo;
+    }
+    if (head & TOKEN_HAS_SPECIAL) {
+      putVarint(special);
+    } else if (head & TOKEN_SEEN_SPECIAL) {
+      out[len++] = slot;
+    }
+    prevEnd = p + length;
+  }
+
+  const [hashLo, hashHi] = streamHash(source);
+  const dv = new DataView(out.buffer);
+  dv.setUint32(0, MAGIC, true);
+  dv.setUint16(4, STREAM_VERSION, true);
+  dv.setUint16(6, scan ? STREAM_SCAN : 0, true);
+  dv.setUint32(8, source.length, true);
+  dv.setUint32(12, count, true);
+  dv.setUint32(16, hashLo, true);
+  dv.setUint32(20, hashHi, true);
+  dv.setUint32(24, len - STREAM_HEADER, true);
+  dv.setInt32(28, ret, true);
+  dv.setUint32(32, errorAt, true);
+  dv.setUint32(36, errorLine, true);
+  return out.subarray(0, len);
+}
+
+/**
+ * Decodes a stream into events for "replay.js", with token offsets relative to the start of its
+ * source. This doesn't check the source hash, so callers must know that the stream matches.
+ *
+ * @param {Uint8Array} data
+ * @return {DecodedStream?} null if this is not a valid stream
+ */
+export function decodeStream(data) {
+  if (data.length < STREAM_HEADER) {
+    return null;
+  }
+  const dv = new DataView(data.buffer, data.byteOffset, data.byteLength);
+  if (dv.getUint32(0, true) !== MAGIC || dv.getUint16(4, true) !== STREAM_VERSION ||
+      dv.getUint32(24, true) !== data.length - STREAM_HEADER) {
+    return null;
+  }
+  const sourceLength = dv.getUint32(8, true);
+  const count = dv.getUint32(12, true);
+
+  let at = STREAM_HEADER;
+  let invalid = false;
+  const getVarint = () => {
+    let v = 0;
+    for (let shift = 0; shift < 35 && at < data.length; shift += 7) {
+      const b = data[at++];
+      v += (b & 0x7f) * 2 ** shift;
+      if (!(b & 0x80)) {
+        return v >>> 0;
+      }
+    }
+    invalid = true;
+    return 0;
+  };
+  const unzigzag = (/** @type {number} */ v) => (v >>> 1) ^ -(v & 1);
+
+  const events = new Int32Array(count * EVENT_WORDS);
+  const seen = new Int32Array(1 << SEEN_BITS);
+  let prevEnd = 0;
+  let lineNo = 1;
+
+  for (let i = 0; i < events.length; i += EVENT_WORDS) {
+    const head = getVarint();
+    const kind = head & 3;
+    if (kind === KIND_OPEN || kind === KIND_CLOSE) {
+      events[i] = kind === KIND_OPEN ? EVENT_OPEN : EVENT_CLOSE;
+      events[i + 1] = head >>> 2;
+      continue;
+    } else if (kind !== KIND_TOKEN) {
+      return null;
+    }
+
+    const vp = prevEnd + unzigzag(getVarint());
+    const p = vp + getVarint();
+    const length = getVarint();
+    if (head & TOKEN_HAS_LINE) {
+      lineNo += unzigzag(getVarint());
+    }
+    let special = 0;
+    if (head & TOKEN_HAS_SPECIAL) {
+      special = getVarint() | 0;
+      seen[seenSlot(special)] = special;
+    } else if (head & TOKEN_SEEN_SPECIAL) {
+      special = at < data.length ? seen[data[at++] & ((1 << SEEN_BITS) - 1)] : 0;
+    }
+    if (invalid || vp < 0 || p < vp || p + length > sourceLength) {
+      return null;
+    }
+
+    events[i] = vp;
+    events[i + 1] = p;
+    events[i + 2] = length;
+    events[i + 3] = lineNo;
+    events[i + 4] = head >>> TOKEN_TYPE_SHIFT;
+    events[i + 5] = special;
+    prevEnd = p + length;
+  }
+  if (at !== data.length) {
+    return null;
+  }
+
+  return {
+    flags: dv.getUint16(6, true),
+    sourceLength,
+    ret: dv.getInt32(28, true),
+    errorAt: dv.getUint32(32, true),
+    errorLine: dv.getUint32(36, true),
+    events,
+    count,
+  };
+}
@@ -31,9 +31,17 @@ type StackValues = typeof import('./v-stacks.js')[keyof typeof import('./v-stack
 export interface InternalCalls {
   __wasm_call_ctors(): void;
 
+  // missing from lexer runners
   blep_parser_init(at: number, len: number): number;
-  blep_parser_run(): number;
+  blep_parser_run?(): number;  // also missing from imports runners
+  blep_parser_scan?(): number;
   blep_parser_cursor(): number;
+
+  // missing from older runners
+  blep_token_init?(at: number, len: number): number;
+  blep_token_next?(): number;
+  blep_token_cursor?(): number;
+  blep_token_records?(at: number, cap: number): number;
 }
 
 /**
@@ -41,6 +49,7 @@ export interface InternalCalls {
  */
 export interface InternalImports {
   memset(at: number, byte: number, size: number): void;
+  memcpy(dest: number, src: number, size: number): number;
   memchr(at: number, byte: number, size: number): number;
 
   blep_parser_callback(): void;
@@ -136,11 +145,30 @@ export interface Base {
   token: Token;
 
   /**
-   * Runs the parser over the entire source. Clears handlers on finish.
+   * Runs the parser over the entire source, or the passed byte range of it. Token locations are
+   * always relative to the start of the source, but line numbers restart for each range. Clears
+   * handlers on finish.
+   *
+   * With a lexer runner, this instead announces every token as classified by the tokenizer alone
+   * (e.g., keywords are lits), without stacks, and returns the number of tokens. Runners built only
+   * for imports throw here, see {@link Base.scan}.
    *
    * @returns number of top-level statements
    */
-  run(): number;
+  run(start?: number, end?: number): number;
+
+  /**
+   * Runs the scanner over the entire source. This only parses module statements (i.e., top-level
+   * `import` and `export`, plus `import(...)` anywhere), announcing them with the same tokens and
+   * stacks as {@link Base.run}. Everything else is skipped by balancing brackets only, without
+   * generating callbacks or stacks. Clears handlers on finish.
+   *
+   * Older runners without a scanner will instead parse the entire source. Accepts a byte range
+   * like {@link Base.run}.
+   *
+   * @returns number of steps taken
+   */
+  scan(start?: number, end?: number): number;
 
   /**
    * Replaces any number of handlers with passed handlers.
@@ -163,10 +191,46 @@ export interface Harness extends Base {
 
 }
 
+/**
+ * A harness over a WASM runner, which can also tokenize directly into an array.
+ */
+export interface LexerHarness extends Harness {
+
+  /**
+   * Tokenizes the entire source, or the passed byte range of it, into an array of four words per
+   * token: its location (relative to the start of the source), length, special, and line number
+   * shifted left by five bits OR'd with its type. Handlers are not called.
+   *
+   * This runs only the tokenizer, so tokens are classified as for a lexer runner's {@link Base.run}
+   * (e.g., keywords are lits, and `/` is guessed from the previous token). Older runners without
+   * an exported tokenizer instead fill the array from a full parse.
+   */
+  tokens(start?: number, end?: number): Uint32Array;
+
+}
+
 export interface RewriterArgs {
   callback(): Uint8Array|string|void;
   stack(type: StackValues): boolean|void;
+
+  /**
+   * Called as a stack closes, after {@link RewriterArgs.stack} is called with zero. Returned
+   * content is inserted directly after the last token of the stack.
+   */
+  close(): Uint8Array|string|void;
   write(part: Uint8Array): void;
+
+  /**
+   * Whether to use {@link Base.scan} rather than a full parse, for rewriters which only care about
+   * module statements.
+   */
+  scan: boolean;
+
+  /**
+   * Whether the file is HTML, in which case only its inline module scripts are parsed. Defaults to
+   * checking for a ".html" or ".htm" extension.
+   */
+  html: boolean;
 }
 
 export interface RewriterReturn {
@@ -23,4 +23,6 @@ export const external = 32;
 export const destructuring = 64;
 const _default = 128;
 export {_default as default};
+export const dynamic = 256;
+export const meta = 512;
 export const lit = 1073741824;  // this is (1 << 30) but tsc doesn't like expanding it
\ No newline at end of file
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#include "gumnut.h"
+#include "../core/parser.h"
+
+#include <stddef.h>
+
+// The parser calls out to link-time symbols, so dispatch them to the active handlers. Like the
+// parser's own state, these are per-thread.
+static _THREAD_LOCAL const gumnut_handlers *active;
+static _THREAD_LOCAL struct token *cursor;
+static _THREAD_LOCAL int steps;
+
+void blep_parser_callback() {
+  if (active->callback) {
+    active->callback(active->user, cursor);
+  }
+}
+
+int blep_parser_open(int type) {
+  return active->open ? active->open(active->user, type) : 0;
+}
+
+void blep_parser_close(int type) {
+  if (active->close) {
+    active->close(active->user, type);
+  }
+}
+
+static int run(char *p, int len, const gumnut_handlers *handlers, int (*step)()) {
+  static const gumnut_handlers empty = {NULL, NULL, NULL, NULL};
+  active = handlers ? handlers : &empty;
+  cursor = blep_parser_cursor();
+
+  steps = 0;
+  int ret = blep_parser_init(p, len);
+  if (ret >= 0) {
+    do {
+      ret = step();
+      ++steps;
+    } while (ret > 0);
+  }
+
+  active = &empty;
+  return ret;
+}
+
+int gumnut_run(char *p, int len, const gumnut_handlers *handlers) {
+  return run(p, len, handlers, blep_parser_run);
+}
+
+int gumnut_scan(char *p, int len, const gumnut_handlers *handlers) {
+  return run(p, len, handlers, blep_parser_scan);
+}
+
+int gumnut_steps() {
+  return steps;
+}
+
+struct token *gumnut_cursor() {
+  return blep_parser_cursor();
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#ifndef __GUMNUT_H
+#define __GUMNUT_H
+
+#include "../core/token.h"
+#include "../core/def.h"
+
+// Handlers for a run. Any may be NULL. The passed token is only valid during the callback, but can
+// be kept via blep_token_record() as a compact struct token_record.
+typedef struct {
+  void (*callback)(void *user, struct token *t);
+  int (*open)(void *user, int type);  // return non-zero to skip this stack's contents and close
+  void (*close)(void *user, int type);
+  void *user;
+} gumnut_handlers;
+
+// Parses the passed source of len bytes. This never reads past p[len], so it need not be followed by
+// a NULL byte (e.g., a read-only mmap of a file). Returns zero on success, or a negative ERROR__
+// value, in which case gumnut_cursor() is where it failed. Parser state is per-thread, so separate
+// threads can each run at once.
+//
+// Nested statements and expressions recurse on the calling thread's stack, using up to about 160
+// bytes per level when optimized and 460 without. Nesting past PARSER_MAX_DEPTH (by default 4096,
+// or about 700KB optimized) fails with ERROR__STACK. A build with a higher PARSER_MAX_DEPTH must
+// call this on a thread with PARSER_STACK_SIZE of stack.
+int gumnut_run(char *p, int len, const gumnut_handlers *handlers);
+
+// As gumnut_run, but only announces module statements (see blep_parser_scan).
+int gumnut_scan(char *p, int len, const gumnut_handlers *handlers);
+
+// The number of steps taken by the last gumnut_run or gumnut_scan on this thread, including the
+// final step which found the end. This is what the JS harness returns from run() and scan().
+int gumnut_steps();
+
+// The current token, which is where a failed run stopped.
+struct token *gumnut_cursor();
+
+#endif//__GUMNUT_H
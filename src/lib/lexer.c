@@ -0,0 +1,206 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#include "lexer.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A token which fails this close to the end of a chunk might just be incomplete (e.g., "\u{...}").
+#define INCOMPLETE_SLOP 16
+
+// The tokenizer peeks up to two bytes past some tokens (e.g., "." before "..", or a symbol before
+// "\u"), so tokens must end this far before the end of a chunk to be certain.
+#define LOOKAHEAD 4
+
+// Kinds of incomplete token which are only tokenized again once a byte which might end them arrives.
+// Anything else is short (e.g., a name running to the end of a chunk), so is just tokenized again.
+#define LEXER_WAIT_STRING   1
+#define LEXER_WAIT_TEMPLATE 2
+#define LEXER_WAIT_REGEXP   3
+#define LEXER_WAIT_LINE     4  // line comment
+#define LEXER_WAIT_BLOCK    5  // block comment
+
+void gumnut_lexer_init(gumnut_lexer *lx) {
+  memset(lx, 0, sizeof(gumnut_lexer));
+}
+
+void gumnut_lexer_free(gumnut_lexer *lx) {
+  free(lx->buf);
+  memset(lx, 0, sizeof(gumnut_lexer));
+}
+
+// finds the kind of an incomplete token, which was announced as running to the end of input
+static int token_wait(gumnut_lexer *lx, struct token *t) {
+  switch (t->type) {
+    case TOKEN_STRING:
+      if (t->p[0] == '`' || t->p[0] == '}') {
+        return LEXER_WAIT_TEMPLATE;
+      }
+      lx->quote = t->p[0];
+      return LEXER_WAIT_STRING;
+
+    case TOKEN_REGEXP:
+      return LEXER_WAIT_REGEXP;
+  }
+  return 0;
+}
+
+// finds the kind of a comment left open at end, from spaces and comments which run from p to end
+static int void_wait(char *p, char *end) {
+  while (p + 1 < end) {
+    if (p[0] != '/') {
+      ++p;
+    } else if (p[1] == '/') {
+      p = memchr(p, '\n', end - p);
+      if (!p) {
+        return LEXER_WAIT_LINE;
+      }
+    } else if (p[1] == '*') {
+      for (p += 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); ++p);
+      if (p + 1 >= end) {
+        return LEXER_WAIT_BLOCK;
+      }
+      p += 2;
+    } else {
+      ++p;
+    }
+  }
+  return 0;
+}
+
+// whether any of [p,end) might end an incomplete token of the waited kind
+static int may_end(gumnut_lexer *lx, char *p, char *end) {
+  for (; p < end; ++p) {
+    char c = *p;
+    switch (lx->wait) {
+      case LEXER_WAIT_STRING:
+        if (c == lx->quote) {
+          return 1;
+        }
+        continue;
+
+      case LEXER_WAIT_TEMPLATE:
+        if (c == '`' || (c == '{' && p > lx->buf && p[-1] == '$')) {
+          return 1;
+        }
+        continue;
+
+      case LEXER_WAIT_REGEXP:
+        if (c == '/' || c == '\n') {
+          return 1;
+        }
+        continue;
+
+      case LEXER_WAIT_LINE:
+        if (c == '\n') {
+          return 1;
+        }
+        continue;
+
+      case LEXER_WAIT_BLOCK:
+        if (c == '/' && p > lx->buf && p[-1] == '*') {
+          return 1;
+        }
+        continue;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+static int lex(gumnut_lexer *lx, int final, const gumnut_handlers *handlers) {
+  lx->wait = 0;
+  int ret = lx->started ? blep_token_resume(lx->buf, lx->len, &lx->state, 0) :
+      blep_token_init(lx->buf, lx->len);
+  if (ret < 0) {
+    return ret;
+  }
+  lx->started = 1;
+
+  int count = 0;
+  for (;;) {
+    struct token prev = td->curr;
+    char *at = td->at;
+    int line_no = td->line_no;
+    int depth = td->depth;
+
+    int type = blep_token_next();
+    if (!final && (type == 0 || td->end - td->at < LOOKAHEAD ||
+        (type < 0 && td->end - td->curr.p < INCOMPLETE_SLOP))) {
+      // this might continue in the next chunk, so undo it (a token only moves depth)
+      if (type > 0) {
+        lx->wait = token_wait(lx, &td->curr);
+      } else if (type == 0) {
+        lx->wait = void_wait(at, td->end);
+      }
+      lx->scanned = lx->len;
+      td->curr = prev;
+      td->at = at;
+      td->line_no = line_no;
+      td->depth = depth;
+      break;
+    } else if (type <= 0) {
+      if (type < 0) {
+        return type;
+      }
+      break;
+    }
+
+    ++count;
+    if (handlers && handlers->callback) {
+      handlers->callback(handlers->user, &td->curr);
+    }
+  }
+
+  blep_token_snapshot(&lx->state);
+  return count;
+}
+
+int gumnut_lexer_feed(gumnut_lexer *lx, const char *chunk, int len, const gumnut_handlers *handlers) {
+  // drop everything before the previous token, which is all the tokenizer needs
+  uint32_t keep = lx->started ? lx->state.prev.at : 0;
+  if (keep) {
+    memmove(lx->buf, lx->buf + keep, lx->len - keep);
+    lx->len -= keep;
+    lx->base += keep;
+    lx->state.at -= keep;
+    lx->state.prev.at -= keep;
+    lx->scanned -= keep;
+  }
+
+  if (lx->len + len > lx->cap) {
+    lx->cap = (lx->len + len) * 2;
+    lx->buf = realloc(lx->buf, lx->cap);
+  }
+  memcpy(lx->buf + lx->len, chunk, len);
+  lx->len += len;
+
+  // if nothing new can end the incomplete token, don't tokenize it all again (the bytes just before
+  // are checked too, as a token ending within LOOKAHEAD of the end is also held)
+  if (lx->wait) {
+    int from = lx->scanned - LOOKAHEAD;
+    if (!may_end(lx, lx->buf + (from > 0 ? from : 0), lx->buf + lx->len)) {
+      lx->scanned = lx->len;
+      return 0;
+    }
+  }
+
+  return lex(lx, 0, handlers);
+}
+
+int gumnut_lexer_end(gumnut_lexer *lx, const gumnut_handlers *handlers) {
+  return lex(lx, 1, handlers);
+}
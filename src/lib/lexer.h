@@ -0,0 +1,63 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Tokenizes input which arrives in chunks (e.g., from a socket or a large file being read), without
+// holding all of it in memory. This runs only the tokenizer, not the parser, so tokens have no stacks
+// and `/` is classified by the tokenizer's own guess of regexp versus division.
+//
+// Only tokens which are certainly complete are announced: a token which runs to (or very near) the
+// end of a chunk might continue in the next, so it's kept (along with the previous token, which the tokenizer
+// looks back at) and tokenized again once more input arrives. Memory is bounded by the largest
+// token plus a chunk.
+//
+// A long string, template, regexp or comment which spans many chunks is tokenized again only once a
+// chunk arrives that might end it, so the work done is linear in its length.
+
+#ifndef __GUMNUT_LEXER_H
+#define __GUMNUT_LEXER_H
+
+#include "gumnut.h"
+#include <stdint.h>
+
+typedef struct {
+  char *buf;
+  int len;
+  int cap;
+  uint32_t base;  // offset of buf[0] within the whole input
+  int started;
+  struct token_snapshot state;
+
+  int wait;      // kind of incomplete token held (LEXER_WAIT_ in lexer.c), or zero
+  char quote;    // quote of an incomplete string
+  int scanned;   // length of buf when the incomplete token was last tokenized
+} gumnut_lexer;
+
+void gumnut_lexer_init(gumnut_lexer *lx);
+void gumnut_lexer_free(gumnut_lexer *lx);
+
+// Appends a chunk, announcing every complete token to handlers->callback (open and close are never
+// called). Returns the number of tokens announced, or a negative ERROR__ value.
+int gumnut_lexer_feed(gumnut_lexer *lx, const char *chunk, int len, const gumnut_handlers *handlers);
+
+// Announces any remaining tokens, as there's no more input. Returns as gumnut_lexer_feed.
+int gumnut_lexer_end(gumnut_lexer *lx, const gumnut_handlers *handlers);
+
+// Offset of a token pointer (valid only during the callback) within the whole input.
+static inline uint32_t gumnut_lexer_offset(const gumnut_lexer *lx, const char *p) {
+  return lx->base + (p - lx->buf);
+}
+
+#endif//__GUMNUT_LEXER_H
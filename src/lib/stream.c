@@ -0,0 +1,430 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#include "stream.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define KIND_TOKEN  0
+#define KIND_OPEN   1
+#define KIND_CLOSE  2
+
+#define TOKEN_HAS_LINE     4
+#define TOKEN_HAS_SPECIAL  8
+#define TOKEN_SEEN_SPECIAL 16  // special is an index into recently seen specials
+#define TOKEN_TYPE_SHIFT   5
+
+// Keyword and operator specials are large hashes which repeat often, so both sides keep a table of
+// recent specials, and a repeat is written as a one-byte index.
+#define SEEN_BITS  6
+#define seen_slot(_special) (((_special) * 0x9e3779b1u) >> (32 - SEEN_BITS))
+
+static const uint8_t magic[4] = {'G', 'M', 'N', 'T'};
+
+typedef struct {
+  uint8_t *buf;
+  size_t len;
+  size_t cap;
+
+  char *source;
+  int prev_end;
+  int prev_line;
+  uint32_t count;
+  uint32_t seen[1 << SEEN_BITS];
+  int failed;  // out of memory, so events are dropped
+} writer;
+
+// Numbers temporary files, as threads of a process share its pid.
+static unsigned temp_counter;
+
+uint64_t gumnut_hash(const char *p, int len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < len; ++i) {
+    hash ^= (uint8_t) p[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+static inline uint32_t zigzag(int32_t v) {
+  return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+  return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+static void put_u16(uint8_t *at, uint32_t v) {
+  at[0] = v;
+  at[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *at, uint32_t v) {
+  put_u16(at, v);
+  put_u16(at + 2, v >> 16);
+}
+
+static uint32_t get_u16(const uint8_t *at) {
+  return at[0] | (at[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *at) {
+  return get_u16(at) | (get_u16(at + 2) << 16);
+}
+
+// ensures room for one more event, which is at most six 5-byte varints, or returns NULL if out of
+// memory (after which every event is dropped, and encoding fails)
+static inline uint8_t *reserve(writer *w) {
+  if (w->len + 30 > w->cap && !w->failed) {
+    size_t cap = (w->cap + 30) * 2;
+    uint8_t *buf = realloc(w->buf, cap);
+    if (buf) {
+      w->buf = buf;
+      w->cap = cap;
+    } else {
+      w->failed = 1;
+    }
+  }
+  return w->failed ? NULL : w->buf + w->len;
+}
+
+static inline uint8_t *put_varint(uint8_t *at, uint32_t v) {
+  while (v >= 0x80) {
+    *at++ = v | 0x80;
+    v >>= 7;
+  }
+  *at++ = v;
+  return at;
+}
+
+static void write_callback(void *user, struct token *t) {
+  writer *w = user;
+  uint8_t *at = reserve(w);
+  if (!at) {
+    return;
+  }
+
+  int vp = t->vp - w->source;
+  int p = t->p - w->source;
+  int head = (t->type << TOKEN_TYPE_SHIFT) | KIND_TOKEN;
+  uint32_t slot = seen_slot(t->special);
+  if (!t->special) {
+    // nothing to write
+  } else if (w->seen[slot] == t->special) {
+    head |= TOKEN_SEEN_SPECIAL;
+  } else {
+    head |= TOKEN_HAS_SPECIAL;
+    w->seen[slot] = t->special;
+  }
+  if (t->line_no != w->prev_line) {
+    head |= TOKEN_HAS_LINE;
+  }
+
+  at = put_varint(at, head);
+  at = put_varint(at, zigzag(vp - w->prev_end));
+  at = put_varint(at, p - vp);
+  at = put_varint(at, t->len);
+  if (head & TOKEN_HAS_LINE) {
+    at = put_varint(at, zigzag(t->line_no - w->prev_line));
+    w->prev_line = t->line_no;
+  }
+  if (head & TOKEN_HAS_SPECIAL) {
+    at = put_varint(at, t->special);
+  } else if (head & TOKEN_SEEN_SPECIAL) {
+    *at++ = slot;
+  }
+
+  w->prev_end = p + t->len;
+  w->len = at - w->buf;
+  ++w->count;
+}
+
+static int write_open(void *user, int type) {
+  writer *w = user;
+  uint8_t *at = reserve(w);
+  if (at) {
+    w->len = put_varint(at, (type << 2) | KIND_OPEN) - w->buf;
+    ++w->count;
+  }
+  return 0;  // record everything, skipping happens on replay
+}
+
+static void write_close(void *user, int type) {
+  writer *w = user;
+  uint8_t *at = reserve(w);
+  if (at) {
+    w->len = put_varint(at, (type << 2) | KIND_CLOSE) - w->buf;
+    ++w->count;
+  }
+}
+
+int gumnut_stream_encode(char *p, int len, int scan, uint8_t **out, size_t *out_len) {
+  writer w = {0};
+  w.source = p;
+  w.prev_line = 1;
+  w.len = GUMNUT_STREAM_HEADER;
+  w.cap = GUMNUT_STREAM_HEADER + len;  // usually larger than needed
+  w.buf = malloc(w.cap);
+  if (!w.buf) {
+    *out = NULL;
+    return ERROR__INTERNAL;
+  }
+
+  gumnut_handlers h = {write_callback, write_open, write_close, &w};
+  int ret = scan ? gumnut_scan(p, len, &h) : gumnut_run(p, len, &h);
+  if (w.failed) {
+    free(w.buf);
+    *out = NULL;
+    return ERROR__INTERNAL;
+  }
+
+  uint32_t error_at = 0, error_line = 0;
+  if (ret < 0) {
+    struct token *cursor = gumnut_cursor();
+    error_at = cursor->p - p;
+    error_line = cursor->line_no;
+  }
+
+  uint64_t hash = gumnut_hash(p, len);
+  uint8_t *header = w.buf;
+  memcpy(header, magic, 4);
+  put_u16(header + 4, GUMNUT_STREAM_VERSION);
+  put_u16(header + 6, scan ? GUMNUT_STREAM_SCAN : 0);
+  put_u32(header + 8, len);
+  put_u32(header + 12, w.count);
+  put_u32(header + 16, hash);
+  put_u32(header + 20, hash >> 32);
+  put_u32(header + 24, w.len - GUMNUT_STREAM_HEADER);
+  put_u32(header + 28, ret);
+  put_u32(header + 32, error_at);
+  put_u32(header + 36, error_line);
+
+  *out = w.buf;
+  *out_len = w.len;
+  return ret;
+}
+
+int gumnut_stream_write(const char *path, char *p, int len, int scan) {
+  uint8_t *buf;
+  size_t buf_len;
+  int ret = gumnut_stream_encode(p, len, scan, &buf, &buf_len);
+  if (!buf) {
+    return ret;
+  }
+
+  size_t tmp_len = strlen(path) + 32;
+  char *tmp = malloc(tmp_len);
+  if (!tmp) {
+    free(buf);
+    return ERROR__INTERNAL;
+  }
+  unsigned n = __atomic_fetch_add(&temp_counter, 1, __ATOMIC_RELAXED);
+  snprintf(tmp, tmp_len, "%s.%d.%u.tmp", path, (int) getpid(), n);
+
+  FILE *f = fopen(tmp, "wb");
+  int ok = f && fwrite(buf, 1, buf_len, f) == buf_len;
+  if (f && fclose(f) != 0) {
+    ok = 0;
+  }
+  if (!ok || rename(tmp, path) != 0) {
+    unlink(tmp);
+    ret = ERROR__INTERNAL;
+  }
+
+  free(tmp);
+  free(buf);
+  return ret;
+}
+
+int gumnut_stream_load(gumnut_stream *s, const uint8_t *data, size_t len) {
+  memset(s, 0, sizeof(gumnut_stream));
+  if (len < GUMNUT_STREAM_HEADER || memcmp(data, magic, 4)) {
+    return ERROR__INTERNAL;
+  }
+
+  gumnut_stream_header *h = &s->header;
+  h->version = get_u16(data + 4);
+  h->flags = get_u16(data + 6);
+  h->source_len = get_u32(data + 8);
+  h->count = get_u32(data + 12);
+  h->source_hash = get_u32(data + 16) | ((uint64_t) get_u32(data + 20) << 32);
+  h->body_len = get_u32(data + 24);
+  h->ret = (int32_t) get_u32(data + 28);
+  h->error_at = get_u32(data + 32);
+  h->error_line = get_u32(data + 36);
+
+  if (h->version != GUMNUT_STREAM_VERSION || h->body_len != len - GUMNUT_STREAM_HEADER) {
+    return ERROR__INTERNAL;
+  }
+  s->body = data + GUMNUT_STREAM_HEADER;
+  return 0;
+}
+
+int gumnut_stream_open(gumnut_stream *s, const char *path) {
+  memset(s, 0, sizeof(gumnut_stream));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return ERROR__INTERNAL;
+  }
+
+  struct stat st;
+  void *mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= GUMNUT_STREAM_HEADER) {
+    mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return ERROR__INTERNAL;
+  }
+
+  int ret = gumnut_stream_load(s, mapped, st.st_size);
+  if (ret < 0) {
+    munmap(mapped, st.st_size);
+    return ret;
+  }
+  s->mapped = mapped;
+  s->mapped_len = st.st_size;
+  return 0;
+}
+
+void gumnut_stream_close(gumnut_stream *s) {
+  if (s->mapped) {
+    munmap(s->mapped, s->mapped_len);
+  }
+  memset(s, 0, sizeof(gumnut_stream));
+}
+
+int gumnut_stream_matches(const gumnut_stream *s, const char *p, int len) {
+  return s->body && s->header.source_len == (uint32_t) len &&
+      s->header.source_hash == gumnut_hash(p, len);
+}
+
+void gumnut_stream_iter_init(gumnut_stream_iter *it, const gumnut_stream *s, char *source) {
+  memset(it, 0, sizeof(gumnut_stream_iter));
+  it->at = s->body;
+  it->end = s->body + s->header.body_len;
+  it->source = source;
+  it->source_len = s->header.source_len;
+  it->token.line_no = 1;
+}
+
+// reads a varint, setting it->at past the end of the stream if it's truncated
+static inline uint32_t get_varint(gumnut_stream_iter *it) {
+  uint32_t v = 0;
+  for (int shift = 0; shift < 35 && it->at < it->end; shift += 7) {
+    uint8_t b = *it->at++;
+    v |= (uint32_t) (b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return v;
+    }
+  }
+  it->at = it->end + 1;
+  return 0;
+}
+
+int gumnut_stream_next(gumnut_stream_iter *it) {
+  if (it->at >= it->end) {
+    return 0;
+  }
+
+  uint32_t head = get_varint(it);
+  switch (head & 3) {
+    case KIND_OPEN:
+      it->stack = head >> 2;
+      return GUMNUT_EVENT_OPEN;
+
+    case KIND_CLOSE:
+      it->stack = head >> 2;
+      return GUMNUT_EVENT_CLOSE;
+
+    case KIND_TOKEN:
+      break;
+
+    default:
+      return ERROR__INTERNAL;
+  }
+
+  struct token *t = &it->token;
+  int vp = it->prev_end + unzigzag(get_varint(it));
+  int p = vp + get_varint(it);
+  t->len = get_varint(it);
+  t->type = head >> TOKEN_TYPE_SHIFT;
+  if (head & TOKEN_HAS_LINE) {
+    t->line_no += unzigzag(get_varint(it));
+  }
+  if (head & TOKEN_HAS_SPECIAL) {
+    t->special = get_varint(it);
+    it->seen[seen_slot(t->special)] = t->special;
+  } else if (head & TOKEN_SEEN_SPECIAL) {
+    t->special = it->at < it->end ? it->seen[*it->at++ & ((1 << SEEN_BITS) - 1)] : 0;
+  } else {
+    t->special = 0;
+  }
+  if (it->at > it->end || vp < 0 || p < vp || p + t->len > it->source_len) {
+    return ERROR__INTERNAL;
+  }
+
+  t->vp = it->source + vp;
+  t->p = it->source + p;
+  it->prev_end = p + t->len;
+  return GUMNUT_EVENT_TOKEN;
+}
+
+int gumnut_stream_replay(const gumnut_stream *s, char *source, const gumnut_handlers *handlers) {
+  static const gumnut_handlers empty = {NULL, NULL, NULL, NULL};
+  if (!handlers) {
+    handlers = &empty;
+  }
+
+  gumnut_stream_iter it;
+  gumnut_stream_iter_init(&it, s, source);
+
+  // depth within a stack skipped by its open handler
+  int skip = 0;
+  int event;
+  while ((event = gumnut_stream_next(&it)) > 0) {
+    switch (event) {
+      case GUMNUT_EVENT_TOKEN:
+        if (!skip && handlers->callback) {
+          handlers->callback(handlers->user, &it.token);
+        }
+        break;
+
+      case GUMNUT_EVENT_OPEN:
+        if (skip) {
+          ++skip;
+        } else if (handlers->open && handlers->open(handlers->user, it.stack)) {
+          skip = 1;
+        }
+        break;
+
+      case GUMNUT_EVENT_CLOSE:
+        if (skip) {
+          --skip;
+        } else if (handlers->close) {
+          handlers->close(handlers->user, it.stack);
+        }
+        break;
+    }
+  }
+
+  return event < 0 ? event : s->header.ret;
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Serializes a parse of a file (its tokens and stack events) so it can be replayed without
+// parsing again. Streams are tied to their source by length and hash.
+//
+// The format is a fixed little-endian header followed by one varint-encoded record per event:
+//
+//   header (40 bytes)
+//     "GMNT" magic, u16 version, u16 flags (GUMNUT_STREAM_SCAN)
+//     u32 source length, u32 event count, u64 FNV-1a hash of source
+//     u32 body length, i32 parse result, u32 error offset, u32 error line
+//
+//   token:  varint (type << 5 | seen_special << 4 | has_special << 3 | has_line << 2 | 0)
+//           varint zigzag(void - end of previous token), varint (at - void), varint length,
+//           [varint line delta], [varint special | u8 index of a recently seen special]
+//
+// Recently seen specials are a 64-entry table indexed by a multiplicative hash of the special,
+// updated by every token with has_special, so writer and reader stay in sync.
+//   open:   varint (stack << 2 | 1)
+//   close:  varint (stack << 2 | 2)
+
+#ifndef __GUMNUT_STREAM_H
+#define __GUMNUT_STREAM_H
+
+#include "gumnut.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define GUMNUT_STREAM_VERSION  1
+#define GUMNUT_STREAM_HEADER   40
+#define GUMNUT_STREAM_SCAN     1  // flag: stream is from gumnut_scan
+
+#define GUMNUT_EVENT_TOKEN  1
+#define GUMNUT_EVENT_OPEN   2
+#define GUMNUT_EVENT_CLOSE  3
+
+typedef struct {
+  int version;
+  int flags;
+  uint32_t source_len;
+  uint32_t count;
+  uint64_t source_hash;
+  uint32_t body_len;
+  int ret;
+  uint32_t error_at;
+  uint32_t error_line;
+} gumnut_stream_header;
+
+typedef struct {
+  gumnut_stream_header header;
+  const uint8_t *body;
+  void *mapped;  // non-NULL if opened from a file
+  size_t mapped_len;
+} gumnut_stream;
+
+typedef struct {
+  const uint8_t *at;
+  const uint8_t *end;
+  char *source;
+  int source_len;
+  int prev_end;
+  uint32_t seen[64];
+  struct token token;  // current token, if the last event was GUMNUT_EVENT_TOKEN
+  int stack;           // current stack, if the last event was an open or close
+} gumnut_stream_iter;
+
+// FNV-1a 64-bit hash, used to check that a stream matches its source.
+uint64_t gumnut_hash(const char *p, int len);
+
+// Parses the passed source (via gumnut_scan if scan is set) and encodes it into a new buffer which
+// the caller must free(). Returns the parse result, which is also recorded in the stream, or
+// ERROR__INTERNAL with *out set to NULL if it ran out of memory.
+int gumnut_stream_encode(char *p, int len, int scan, uint8_t **out, size_t *out_len);
+
+// As gumnut_stream_encode, but writes the stream to a file via a temporary file and rename, so
+// concurrent readers never see a partial stream. Returns the parse result, or ERROR__INTERNAL if
+// it could not be written.
+int gumnut_stream_write(const char *path, char *p, int len, int scan);
+
+// Reads a stream from memory without copying it. Returns zero, or ERROR__INTERNAL if it's not a
+// valid stream of this version.
+int gumnut_stream_load(gumnut_stream *s, const uint8_t *data, size_t len);
+
+// Maps a stream file read-only. Must be closed with gumnut_stream_close.
+int gumnut_stream_open(gumnut_stream *s, const char *path);
+void gumnut_stream_close(gumnut_stream *s);
+
+// Whether this stream was generated from the passed source.
+int gumnut_stream_matches(const gumnut_stream *s, const char *p, int len);
+
+// Iterates over a stream's events. Token pointers are into the passed source, which must be what
+// the stream was generated from. Returns a GUMNUT_EVENT_ value, zero at the end, or ERROR__INTERNAL
+// if the stream is corrupt.
+void gumnut_stream_iter_init(gumnut_stream_iter *it, const gumnut_stream *s, char *source);
+int gumnut_stream_next(gumnut_stream_iter *it);
+
+// Replays a stream into handlers, as if gumnut_run or gumnut_scan had been called again. A stack
+// is skipped if its open handler returns non-zero, including its close. Returns the recorded
+// parse result, or ERROR__INTERNAL if the stream is corrupt.
+int gumnut_stream_replay(const gumnut_stream *s, char *source, const gumnut_handlers *handlers);
+
+#endif//__GUMNUT_STREAM_H
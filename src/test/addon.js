@@ -0,0 +1,131 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildAddonHarness, {loadAddon} from '../harness/addon-harness.js';
+import {buildReplay, EVENT_OPEN, EVENT_CLOSE} from '../harness/replay.js';
+import {specials, stacks, types} from '../harness/common.js';
+
+import test from 'ava';
+
+test.serial('replay skips stacks', (t) => {
+  const source = new TextEncoder().encode('a b c');
+  const {token, replay} = buildReplay(() => source);
+
+  const events = new Int32Array([
+    EVENT_OPEN, stacks.expr, 0, 0, 0, 0,
+    0, 0, 1, 1, types.symbol, 0,
+    EVENT_OPEN, stacks.inner, 0, 0, 0, 0,
+    1, 2, 1, 1, types.symbol, 0,
+    EVENT_CLOSE, stacks.inner, 0, 0, 0, 0,
+    3, 4, 1, 1, types.symbol, 0,
+    EVENT_CLOSE, stacks.expr, 0, 0, 0, 0,
+  ]);
+
+  /** @type {string[]} */
+  const out = [];
+  replay(events, 7, {
+    callback() {
+      out.push(token.string());
+    },
+    open(type) {
+      out.push(`open:${type}`);
+      return type !== stacks.inner;
+    },
+    close(type) {
+      out.push(`close:${type}`);
+    },
+  });
+
+  t.deepEqual(out, [`open:${stacks.expr}`, 'a', `open:${stacks.inner}`, 'c', `close:${stacks.expr}`]);
+});
+
+const addon = loadAddon();
+if (addon) {
+  const harness = buildAddonHarness(addon);
+
+  /**
+   * @param {string} s
+   * @return {Uint8Array}
+   */
+  const prepare = (s) => {
+    const bytes = new TextEncoder().encode(s);
+    harness.prepare(bytes.length).set(bytes);
+    return bytes;
+  };
+
+  test.serial('addon tokens', (t) => {
+    prepare('import x from "y";\nfoo(`${x}`)');
+
+    /** @type {[string, number, number][]} */
+    const out = [];
+    harness.handle({
+      callback() {
+        out.push([harness.token.string(), harness.token.type(), harness.token.lineNo()]);
+      },
+    });
+    t.is(harness.run(), 3);
+
+    t.deepEqual(out.slice(0, 4), [
+      ['import', types.keyword, 1],
+      ['x', types.symbol, 1],
+      ['from', types.keyword, 1],
+      ['"y"', types.string, 1],
+    ]);
+    t.deepEqual(out.slice(5).map(([s]) => s), ['foo', '(', '`${', 'x', '}`', ')']);
+    t.is(out[5][2], 2);
+  });
+
+  test.serial('addon scan', (t) => {
+    prepare('foo(); import("bar"); export var x;');
+
+    /** @type {number[]} */
+    const specialsOut = [];
+    harness.handle({
+      callback() {
+        if (harness.token.type() === types.string) {
+          specialsOut.push(harness.token.special());
+        }
+      },
+    });
+    harness.scan();
+    t.deepEqual(specialsOut, [specials.external | specials.dynamic]);
+  });
+
+  test.serial('addon error', (t) => {
+    prepare('var x = )');
+    const err = t.throws(() => harness.run());
+    t.true(err.message.startsWith('[1:8] unexpected'));
+
+    prepare('foo(');
+    const eofErr = t.throws(() => harness.run());
+    t.is(eofErr.message, 'Unexpected end of input');
+  });
+
+  test.serial('addon large', (t) => {
+    // more events than the initial array, so the addon grows it
+    const count = 10000;
+    prepare('x;'.repeat(count));
+
+    let tokens = 0;
+    harness.handle({
+      callback() {
+        ++tokens;
+      },
+    });
+    t.is(harness.run(), count + 1);
+    t.is(tokens, count * 2);
+  });
+}
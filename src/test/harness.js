@@ -138,3 +138,44 @@ var a = async () => 123;
 let b = async();
 `);
 });
+
+test.serial('html rewriter', (t) => {
+  const callback = () => {
+    if (token.special() & specials.external && token.type() === types.string) {
+      return `'${token.stringValue()}.js'`;
+    }
+  };
+
+  const {pathname} = new URL('data/page.html', import.meta.url);
+  const parts = [];
+  run(pathname, {callback, write: parts.push.bind(parts)});
+
+  const decoder = new TextDecoder();
+  let out = '';
+  for (const part of parts) {
+    out += decoder.decode(part);
+  }
+
+  t.is(out, `<!DOCTYPE html>
+<!-- <script type="module">import 'commented';</script> -->
+<script src="./external.js" type="module"></script>
+<script>import 'classic';</script>
+<SCRIPT TYPE=Module>
+import x from 'first.js';
+</SCRIPT>
+<p>Hello</p>
+<script async type='module'>import 'second.js';</script>
+`);
+});
+
+test.serial('run range', (t) => {
+  const source = new TextEncoder().encode('a; import x from "y"; b');
+  harness.prepare(source.length).set(source);
+
+  const seen = [];
+  harness.handle({callback: () => seen.push(token.at())});
+  harness.run(3, 21);
+
+  t.deepEqual(seen, [3, 10, 12, 17, 20]);
+  t.throws(() => harness.run(0, source.length + 1));
+});
@@ -0,0 +1,530 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+// Tests the public library API, linked against libgumnut.
+
+#include "../core/parser.h"
+#include "../lib/gumnut.h"
+#include "../lib/lexer.h"
+#include "../lib/stream.h"
+#include "../tokens/lit.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct {
+  int tokens;
+  int opened;
+  int closed;
+  int skip;  // stack type to skip
+} counts;
+
+static void count_callback(void *user, struct token *t) {
+  ++((counts *) user)->tokens;
+}
+
+static int count_open(void *user, int type) {
+  counts *c = user;
+  ++c->opened;
+  return type == c->skip;
+}
+
+static void count_close(void *user, int type) {
+  ++((counts *) user)->closed;
+}
+
+// counts only tokens which are being changed, e.g. assigned or destructured into
+static void change_callback(void *user, struct token *t) {
+  if (t->special & SPECIAL__CHANGE) {
+    ++((counts *) user)->tokens;
+  }
+}
+
+static int failures = 0;
+
+#define _expect(_cond) if (!(_cond)) { printf("failed: %s\n", #_cond); ++failures; }
+
+static void record_callback(void *user, struct token *t) {
+  struct token_record **out = user;
+  blep_token_record(*out, t);
+  ++*out;
+}
+
+static void test_record() {
+  _expect(sizeof(struct token_record) == 16);
+
+  char source[] = "var x = 1;\nfoo('bar')";
+  struct token_record records[16];
+  struct token_record *head = records;
+  gumnut_handlers h = {record_callback, NULL, NULL, &head};
+  _expect(gumnut_run(source, strlen(source), &h) == 0);
+  _expect(head - records == 9);
+
+  struct token_record *number = &records[3];
+  _expect(number->at == 8 && number->len == 1);
+  _expect(_RECORD_TYPE(number) == TOKEN_NUMBER);
+  _expect(_RECORD_LINE(number) == 1);
+
+  struct token_record *string = &records[7];
+  _expect(string->at == 15 && string->len == 5);
+  _expect(_RECORD_TYPE(string) == TOKEN_STRING);
+  _expect(_RECORD_LINE(string) == 2);
+
+  _expect(_RECORD_TYPE(&records[0]) == TOKEN_KEYWORD && records[0].special == LIT_VAR);
+}
+
+static void test_records() {
+  char source[] = "var x = a / b;\nx = /re/g";
+  struct token_record records[16];
+
+  // in batches smaller than the number of tokens
+  _expect(blep_token_init(source, strlen(source)) == 0);
+  int count = 0, ret;
+  while ((ret = blep_token_records(records + count, 4)) > 0) {
+    count += ret;
+  }
+  _expect(ret == 0);
+  _expect(count == 10);
+
+  _expect(_RECORD_TYPE(&records[4]) == TOKEN_OP && records[4].at == 10);
+  _expect(_RECORD_TYPE(&records[9]) == TOKEN_REGEXP && records[9].at == 19 && records[9].len == 5);
+  _expect(_RECORD_LINE(&records[9]) == 2);
+  _expect(_RECORD_TYPE(&records[0]) == TOKEN_LIT);  // keywords need the parser
+
+  char invalid[] = "x = ]";
+  _expect(blep_token_init(invalid, strlen(invalid)) == 0);
+  _expect(blep_token_records(records, 16) < 0);
+}
+
+typedef struct {
+  char buf[4096];
+  int len;
+  int skip;  // stack type to skip
+} trace;
+
+static void trace_callback(void *user, struct token *t) {
+  trace *tr = user;
+  tr->len += snprintf(tr->buf + tr->len, sizeof(tr->buf) - tr->len, "%d:%.*s:%d:%d:%u:%ld ",
+      t->type, t->len, t->p, t->line_no, t->len, t->special, (long) (t->p - t->vp));
+}
+
+static int trace_open(void *user, int type) {
+  trace *tr = user;
+  tr->len += snprintf(tr->buf + tr->len, sizeof(tr->buf) - tr->len, "open:%d ", type);
+  return type == tr->skip;
+}
+
+static void trace_close(void *user, int type) {
+  trace *tr = user;
+  tr->len += snprintf(tr->buf + tr->len, sizeof(tr->buf) - tr->len, "close:%d ", type);
+}
+
+static char stream_path[] = "/tmp/gumnut-test-stream-XXXXXX";
+
+static void *write_streams(void *arg) {
+  char source[] = "import x from 'y';\nexport default x;";
+  int ok = 1;
+  for (int i = 0; i < 200; ++i) {
+    ok &= gumnut_stream_write(stream_path, source, strlen(source), 0) == 0;
+  }
+  return ok ? arg : NULL;
+}
+
+static void test_stream() {
+  char source[] = "import x from 'y';\n\nfunction foo(a, b = `${a}`) {\n  return a?.b / 2;\n}\n"
+      "class Bar extends foo {}\nvar y = /re/g\nlet z";
+  int len = strlen(source);
+
+  uint8_t *buf;
+  size_t buf_len;
+  int ret = gumnut_stream_encode(source, len, 0, &buf, &buf_len);
+  _expect(ret == 0);
+
+  gumnut_stream s;
+  _expect(gumnut_stream_load(&s, buf, buf_len) == 0);
+  _expect(gumnut_stream_matches(&s, source, len));
+  _expect(s.header.ret == ret);
+  _expect(!gumnut_stream_matches(&s, source, len - 1));
+
+  // replay matches a parse, including skipped stacks
+  for (int skip = 0; skip <= STACK__FUNCTION; skip += STACK__FUNCTION) {
+    trace direct = {{0}, 0, skip};
+    trace replayed = {{0}, 0, skip};
+    gumnut_handlers h = {trace_callback, trace_open, trace_close, &direct};
+    _expect(gumnut_run(source, len, &h) == ret);
+    h.user = &replayed;
+    _expect(gumnut_stream_replay(&s, source, &h) == ret);
+    _expect(direct.len > 0 && !strcmp(direct.buf, replayed.buf));
+  }
+
+  // a file is mapped
+  char path[] = "/tmp/gumnut-test-stream-XXXXXX";
+  int fd = mkstemp(path);
+  _expect(fd >= 0);
+  close(fd);
+  _expect(gumnut_stream_write(path, source, len, 1) == 0);
+  gumnut_stream mapped;
+  _expect(gumnut_stream_open(&mapped, path) == 0);
+  _expect(mapped.header.flags == GUMNUT_STREAM_SCAN);
+  _expect(gumnut_stream_matches(&mapped, source, len));
+  counts c = {0};
+  gumnut_handlers h = {count_callback, NULL, NULL, &c};
+  _expect(gumnut_stream_replay(&mapped, source, &h) == 0);
+  _expect(c.tokens == 5);  // only the import
+  gumnut_stream_close(&mapped);
+  unlink(path);
+
+  // threads writing the same path each use their own temporary file
+  fd = mkstemp(stream_path);
+  _expect(fd >= 0);
+  close(fd);
+  pthread_t writers[4];
+  for (int i = 0; i < 4; ++i) {
+    pthread_create(&writers[i], NULL, write_streams, stream_path);
+  }
+  for (int i = 0; i < 4; ++i) {
+    void *result;
+    pthread_join(writers[i], &result);
+    _expect(result != NULL);
+  }
+  _expect(gumnut_stream_open(&mapped, stream_path) == 0);
+  gumnut_stream_close(&mapped);
+  unlink(stream_path);
+
+  // truncated or invalid streams fail
+  gumnut_stream truncated;
+  _expect(gumnut_stream_load(&truncated, buf, buf_len - 1) < 0);
+  buf[0] = 'X';
+  _expect(gumnut_stream_load(&truncated, buf, buf_len) < 0);
+  free(buf);
+
+  // errors are recorded
+  char invalid[] = "var x = )";
+  ret = gumnut_stream_encode(invalid, strlen(invalid), 0, &buf, &buf_len);
+  _expect(ret < 0);
+  _expect(gumnut_stream_load(&s, buf, buf_len) == 0);
+  _expect(s.header.ret == ret && s.header.error_at == 8 && s.header.error_line == 1);
+  free(buf);
+}
+
+typedef struct {
+  gumnut_lexer *lx;
+  char buf[4096];
+  int len;
+} lexer_trace;
+
+static void lexer_callback(void *user, struct token *t) {
+  lexer_trace *tr = user;
+  tr->len += snprintf(tr->buf + tr->len, sizeof(tr->buf) - tr->len, "%d:%u:%d:%d:%u ",
+      t->type, gumnut_lexer_offset(tr->lx, t->p), t->len, t->line_no, t->special);
+}
+
+static void lex_chunks(lexer_trace *tr, char *source, int len, int chunk) {
+  gumnut_lexer lx;
+  gumnut_lexer_init(&lx);
+  tr->lx = &lx;
+  tr->len = 0;
+  gumnut_handlers h = {lexer_callback, NULL, NULL, tr};
+
+  int count = 0;
+  for (int at = 0; at < len; at += chunk) {
+    int ret = gumnut_lexer_feed(&lx, source + at, at + chunk > len ? len - at : chunk, &h);
+    _expect(ret >= 0);
+    count += ret;
+  }
+  int ret = gumnut_lexer_end(&lx, &h);
+  _expect(ret >= 0);
+  _expect(count + ret > 0);
+
+  // only the last chunk, and the tokens at its start, are held
+  _expect(lx.len <= chunk + 64);
+  gumnut_lexer_free(&lx);
+}
+
+static void test_lexer() {
+  char source[] = "var instance = a / 2 /* comment\n*/ + `x${ {y: 1}[\"y\"] }z` ?? /re[/]/g;\n"
+      "// line\nif (x) { y ? z : 0x1f } else return 'str\\'ing'\n"
+      "const \\u{61}b = () => instanceof_ === 1.5e3 + .5;\nfoo(...[a.b]);";
+  int len = strlen(source);
+
+  lexer_trace whole, chunked;
+  lex_chunks(&whole, source, len, len);
+  for (int chunk = 1; chunk < 24; ++chunk) {
+    lex_chunks(&chunked, source, len, chunk);
+    _expect(!strcmp(whole.buf, chunked.buf));
+  }
+
+  // long tokens spanning many chunks (this would take minutes if each chunk tokenized them again)
+  int part = 128 * 1024;
+  char *big = malloc(part * 6 + 256);
+  int big_len = 0;
+  const char *parts[] = {"x = 'a\\'", "';\ny = `", "${z}", "`;\n/* *", " */\n// ", "\nw = /[/]", "/g;\n"};
+  for (int i = 0; i < 7; ++i) {
+    big_len += sprintf(big + big_len, "%s", parts[i]);
+    if (i < 6) {
+      memset(big + big_len, 'a' + i, part);
+      big_len += part;
+    }
+  }
+  for (int i = 0; i < 24; ++i) {
+    big_len += sprintf(big + big_len, "x;");
+  }
+  lex_chunks(&whole, big, big_len, big_len);
+  for (int chunk = 1; chunk < 64; chunk += 31) {
+    lex_chunks(&chunked, big, big_len, chunk);
+    _expect(!strcmp(whole.buf, chunked.buf));
+  }
+  free(big);
+
+  // errors are found once the chunk is long enough to be sure
+  gumnut_lexer lx;
+  gumnut_lexer_init(&lx);
+  char invalid[] = "var x = 1 } + 2 + 3 + 4 + 5 + 6 + 7";
+  _expect(gumnut_lexer_feed(&lx, invalid, strlen(invalid), NULL) < 0);
+  gumnut_lexer_free(&lx);
+}
+
+// nests inner in depth pairs of open and close, e.g. "f(() => f(() => z))"
+static char *nested(const char *open, const char *inner, const char *close, int depth, int *len) {
+  int open_len = strlen(open);
+  int inner_len = strlen(inner);
+  int close_len = strlen(close);
+  *len = (open_len + close_len) * depth + inner_len;
+  char *out = malloc(*len);
+  char *p = out;
+  for (int i = 0; i < depth; ++i, p += open_len) {
+    memcpy(p, open, open_len);
+  }
+  memcpy(p, inner, inner_len);
+  p += inner_len;
+  for (int i = 0; i < depth; ++i, p += close_len) {
+    memcpy(p, close, close_len);
+  }
+  return out;
+}
+
+// runs on a thread with PARSER_STACK_SIZE, as the main thread's stack may be smaller
+static void *test_deep(void *arg) {
+  const char *opens[] = {"if (x) ", "x => ", "a: ", "while (x) ", "if (x) y; else ", "f(function () {",
+      "f(() => {", "f(() => ", NULL};
+  const char *closes[] = {"", "", "", "", "", "})", "})", ")", NULL};
+
+  // callbacks also nest brackets, which need more than the inline stack
+  int *arena = malloc(sizeof(int) * PARSER_MAX_DEPTH);
+  blep_token_arena(arena, PARSER_MAX_DEPTH);
+
+  for (int i = 0; opens[i]; ++i) {
+    int len;
+    char *p = nested(opens[i], "z", closes[i], 10000, &len);
+    counts c = {0};
+    gumnut_handlers h = {count_callback, NULL, NULL, &c};
+    _expect(gumnut_run(p, len, &h) == 0);
+    _expect(c.tokens > 10000);
+    free(p);
+
+    // far too deep fails cleanly, rather than overflowing the C stack (but else-if chains don't nest)
+    p = nested(opens[i], "z", closes[i], PARSER_MAX_DEPTH * 2, &len);
+    int ret = gumnut_run(p, len, NULL);
+    _expect(i == 4 ? ret == 0 : ret == ERROR__STACK);
+    free(p);
+  }
+
+  blep_token_arena(NULL, 0);
+  free(arena);
+  return NULL;
+}
+
+// wraps inner in depth pairs of brackets, e.g. "x = [[0]];"
+static char *brackets(const char *open, const char *close, const char *inner, int depth, int *len) {
+  int open_len = strlen(open);
+  int close_len = strlen(close);
+  int inner_len = strlen(inner);
+  *len = 4 + (open_len + close_len) * depth + inner_len + 1;
+  char *out = malloc(*len);
+  char *p = out;
+  memcpy(p, "x = ", 4);
+  p += 4;
+  for (int i = 0; i < depth; ++i, p += open_len) {
+    memcpy(p, open, open_len);
+  }
+  memcpy(p, inner, inner_len);
+  p += inner_len;
+  for (int i = 0; i < depth; ++i, p += close_len) {
+    memcpy(p, close, close_len);
+  }
+  *p++ = ';';
+  return out;
+}
+
+static void test_arena() {
+  const char *opens[] = {"[", "{a: ", "`${", "[function() { return ", NULL};
+  const char *closes[] = {"]", "}", "}`", "}]", NULL};
+  int arena[4096];
+
+  for (int i = 0; opens[i]; ++i) {
+    int len;
+    char *p = brackets(opens[i], closes[i], "0", 1000, &len);
+    _expect(gumnut_run(p, len, NULL) < 0);
+
+    blep_token_arena(arena, 4096);
+    _expect(gumnut_run(p, len, NULL) == 0);
+
+    // the snapshot only holds the inline stack, but the chunked lexer still sees the rest
+    gumnut_lexer lx;
+    gumnut_lexer_init(&lx);
+    counts c = {0};
+    gumnut_handlers h = {count_callback, NULL, NULL, &c};
+    for (int at = 0; at < len; at += 13) {
+      _expect(gumnut_lexer_feed(&lx, p + at, at + 13 > len ? len - at : 13, &h) >= 0);
+    }
+    _expect(gumnut_lexer_end(&lx, &h) >= 0);
+    _expect(c.tokens >= 2000);
+    gumnut_lexer_free(&lx);
+    free(p);
+
+    p = brackets(opens[i], closes[i], "0", 5000, &len);
+    _expect(gumnut_run(p, len, NULL) < 0);
+    blep_token_arena(NULL, 0);
+    free(p);
+  }
+
+  // deep data reuses one lookahead for every level, but still finds destructuring at the bottom
+  const char *inners[] = {"[a] = b", "{a} = b", "[a]", "[a] + b", NULL};
+  const int changes[] = {2, 2, 1, 1};
+  blep_token_arena(arena, 4096);
+  for (int i = 0; inners[i]; ++i) {
+    for (int j = 0; j < 3; ++j) {  // not functions, which each change their empty name
+      int len;
+      char *p = brackets(opens[j], closes[j], inners[i], 3000, &len);
+      counts c = {0};
+      gumnut_handlers h = {change_callback, NULL, NULL, &c};
+      _expect(gumnut_run(p, len, &h) == 0);
+      _expect(c.tokens == changes[i]);  // "x" and any destructured "a"
+      free(p);
+    }
+  }
+  blep_token_arena(NULL, 0);
+}
+
+// Parses sources which end right before an unreadable page, so any read past the end crashes.
+static void test_unterminated() {
+  static const char *sources[] = {
+    "x",
+    "instanceof",
+    "var foo = bar",
+    "'unterminated",
+    "'escaped\\",
+    "`template ${x}\\",
+    "`template ${",
+    "/* comment",
+    "/*",
+    "// comment",
+    "/",
+    "x = /regexp/gi",
+    "x = /regexp\\",
+    "1.5e",
+    ".",
+    "..",
+    "a?.",
+    "a ??",
+    "a >>>",
+    "x\\u",
+    "x\\u{12",
+    "#!",
+    NULL,
+  };
+
+  long page = sysconf(_SC_PAGESIZE);
+  char *region = mmap(NULL, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  _expect(region != MAP_FAILED);
+  _expect(mprotect(region + page, page, PROT_NONE) == 0);
+
+  counts c = {0};
+  gumnut_handlers h = {count_callback, count_open, count_close, &c};
+
+  for (const char **s = sources; *s; ++s) {
+    int len = strlen(*s);
+    char *p = region + page - len;
+    memcpy(p, *s, len);
+    gumnut_run(p, len, &h);  // many are invalid, but shouldn't crash
+    gumnut_scan(p, len, &h);
+  }
+
+  // a valid source still parses fully
+  const char *valid = "import x from 'y'; foo(x, `${bar}`)";
+  int len = strlen(valid);
+  char *p = region + page - len;
+  memcpy(p, valid, len);
+  _expect(gumnut_run(p, len, &h) == 0);
+  _expect(gumnut_cursor()->type == TOKEN_EOF);
+
+  munmap(region, page * 2);
+}
+
+int main() {
+  gumnut_handlers h = {count_callback, count_open, count_close, NULL};
+
+  char source[] = "import x from 'y';\nfunction foo() { return 1; }";
+  int len = strlen(source);
+
+  counts all = {0};
+  h.user = &all;
+  _expect(gumnut_run(source, len, &h) == 0);
+  _expect(all.tokens == 14);
+  _expect(all.opened == all.closed);
+
+  counts skipped = {0};
+  skipped.skip = STACK__FUNCTION;
+  h.user = &skipped;
+  _expect(gumnut_run(source, len, &h) == 0);
+  _expect(skipped.tokens == 5);  // only the import
+  _expect(skipped.closed == skipped.opened - 1);
+
+  counts scanned = {0};
+  h.user = &scanned;
+  _expect(gumnut_scan(source, len, &h) == 0);
+  _expect(scanned.tokens == 5);
+
+  // NULL handlers are allowed
+  _expect(gumnut_run(source, len, NULL) == 0);
+  _expect(gumnut_steps() == 3);  // two statements, then the end
+
+  char invalid[] = "var x = )";
+  _expect(gumnut_run(invalid, strlen(invalid), &h) < 0);
+  _expect(gumnut_cursor()->p[0] == ')');
+
+  test_record();
+  test_records();
+  test_stream();
+  test_lexer();
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, PARSER_STACK_SIZE);
+  pthread_t deep;
+  pthread_create(&deep, &attr, test_deep, NULL);
+  pthread_join(deep, NULL);
+  pthread_attr_destroy(&attr);
+
+  test_arena();
+  test_unterminated();
+
+  printf("%s\n", failures ? "failed" : "all passed");
+  return failures;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildHarness from '../harness/node-harness.js';
+import buildCachedHarness from '../harness/parse-cache.js';
+import {stacks} from '../harness/common.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+
+import test from 'ava';
+
+const source = `import x, {y as z} from './a.js';
+export * as ns from './b.js';
+export {x as default, z};
+export var v = 1;
+export function f() { return 1; }
+import './c.js';
+if (x) { doSomething(); }`;
+
+/**
+ * @param {any} harness
+ * @param {string} s
+ * @param {{scan?: boolean, skip?: number, start?: number}=} options
+ * @return {string[]}
+ */
+function trace(harness, s, {scan = false, skip = -1, start = 0} = {}) {
+  const bytes = new TextEncoder().encode(s);
+  harness.prepare(bytes.length).set(bytes);
+
+  /** @type {string[]} */
+  const out = [];
+  harness.handle({
+    callback() {
+      const {token} = harness;
+      out.push(`${token.string()}:${token.at()}:${token.lineNo()}:${token.type()}:${token.special()}`);
+    },
+    open(type) {
+      out.push(`open:${type}`);
+      return type !== skip;
+    },
+    close(type) {
+      out.push(`close:${type}`);
+    },
+  });
+  out.push(`ret:${scan ? harness.scan(start) : harness.run(start)}`);
+  return out;
+}
+
+test.serial('parse cache', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-cache-'));
+  const plain = await buildHarness();
+  const first = /** @type {any} */ (await buildHarness({cacheDir: dir}));
+  const second = /** @type {any} */ (await buildHarness({cacheDir: dir}));
+
+  for (const scan of [true, false]) {
+    const expected = trace(plain, source, {scan});
+    t.deepEqual(trace(first, source, {scan}), expected);
+    t.deepEqual(trace(second, source, {scan}), expected);
+  }
+  t.deepEqual(first.stats(), {hits: 0, misses: 2, evicted: 0});
+  t.deepEqual(second.stats(), {hits: 2, misses: 0, evicted: 0});
+
+  t.deepEqual(second.summary(), {
+    imports: ['./a.js', './b.js', './c.js'],
+    exports: ['ns', 'default', 'z', 'v', 'f'],
+  });
+
+  // skipped stacks are honored on a hit
+  t.deepEqual(trace(second, source, {skip: stacks.function}), trace(plain, source, {skip: stacks.function}));
+
+  // the same source at a different offset is also a hit
+  const padded = `/* padding */\n${source}`;
+  t.deepEqual(trace(second, padded, {start: 14}), trace(plain, padded, {start: 14}));
+  t.is(second.stats().hits, 4);
+
+  // errors are thrown and not cached
+  t.throws(() => trace(first, 'var x = )'));
+  t.throws(() => trace(second, 'var x = )'));
+  t.is(second.stats().misses, 1);
+
+  fs.rmSync(dir, {recursive: true});
+});
+
+test.serial('parse cache backends', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-cache-'));
+  const plain = await buildHarness();
+  const addon = /** @type {any} */ (buildCachedHarness(plain, {dir, backend: 'addon'}));
+  const wasm = /** @type {any} */ (buildCachedHarness(plain, {dir, backend: 'wasm-0'}));
+
+  trace(addon, source);
+  trace(wasm, source);
+  t.deepEqual(wasm.stats(), {hits: 0, misses: 1, evicted: 0});
+  trace(addon, source);
+  t.deepEqual(addon.stats(), {hits: 1, misses: 1, evicted: 0});
+
+  fs.rmSync(dir, {recursive: true});
+});
+
+test.serial('parse cache eviction', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-cache-'));
+  const harness = /** @type {any} */ (await buildHarness({cacheDir: dir, cacheMaxBytes: 4096}));
+
+  for (let i = 0; i < 64; ++i) {
+    trace(harness, `${source}\nvar unique${i};`);
+  }
+  t.true(harness.stats().evicted > 0);
+
+  let total = 0;
+  for (const sub of fs.readdirSync(dir)) {
+    for (const name of fs.readdirSync(path.join(dir, sub))) {
+      total += fs.statSync(path.join(dir, sub, name)).size;
+    }
+  }
+  t.true(total <= 4096 + 4096 / 8 + 2048, `directory was ${total} bytes`);
+
+  fs.rmSync(dir, {recursive: true});
+});
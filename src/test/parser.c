@@ -2,6 +2,7 @@
 #include "../core/token.h"
 #include "../core/parser.h"
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <stdlib.h>
 
@@ -10,6 +11,10 @@ typedef struct _testdef {
   const char *input;
   int *expected;  // zero-terminated token types
   int is_module;
+  int (*run)();  // blep_parser_run or blep_parser_scan
+  int skip;  // stack type to skip, if any
+  int special_at;  // index of token to check special of, or -1
+  int special;     // special bits expected at special_at
   struct testdef *next;  // for failures
 } testdef;
 
@@ -33,6 +38,13 @@ void blep_parser_callback() {
     expected = 0;
   }
 
+  if (active.at == active.def->special_at && (t->special & active.def->special) != active.def->special) {
+    if (render_output) {
+      printf("%d: special actual=%d expected=%d\n", active.at, t->special, active.def->special);
+    }
+    active.error = 1;
+  }
+
   if (actual != expected) {
     if (render_output) {
       printf("%d: actual=%d expected=%d `%.*s`\n", active.at, actual, expected, t->len, t->p);
@@ -45,7 +57,7 @@ void blep_parser_callback() {
 }
 
 int blep_parser_open(int type) {
-  return 0;
+  return type == active.def->skip;
 }
 
 void blep_parser_close(int type) {
@@ -72,7 +84,7 @@ int run_testdef(testdef *def) {
   int ret = blep_parser_init((char *) def->input, strlen(def->input));
   if (ret >= 0) {
     do {
-      ret = blep_parser_run();
+      ret = def->run();
     } while (ret > 0);
   }
 
@@ -100,12 +112,24 @@ int run_testdef(testdef *def) {
 }
 
 // defines a test for prsr: args must have a trailing comma
-#define _test(_name, _input, ...) \
+#define _test(_name, _input, ...) _test_with(blep_parser_run, 0, -1, 0, _name, _input, __VA_ARGS__)
+
+// defines a test for the scanner, which skips the contents of the passed stack type
+#define _test_scan(_skip, _name, _input, ...) _test_with(blep_parser_scan, _skip, -1, 0, _name, _input, __VA_ARGS__)
+
+// defines a test which also checks the special bits of a single token
+#define _test_special(_at, _special, _name, _input, ...) _test_with(blep_parser_run, 0, _at, _special, _name, _input, __VA_ARGS__)
+
+#define _test_with(_run, _skip, _special_at, _special, _name, _input, ...) \
 { \
   testdef tdef; \
   tdef.name = _name; \
   tdef.input = _input; \
   tdef.is_module = _name[0] == '^'; \
+  tdef.run = _run; \
+  tdef.skip = _skip; \
+  tdef.special_at = _special_at; \
+  tdef.special = _special; \
   tdef.next = NULL; \
   int v[] = {__VA_ARGS__ TOKEN_EOF}; \
   tdef.expected = v; \
@@ -160,6 +184,16 @@ int main() {
     TOKEN_CLOSE,     // :
   );
 
+  _test_special(4, SPECIAL__DECLARE, "arrowfunc after ternary", "a ? b : c => c",
+    TOKEN_SYMBOL,    // a
+    TOKEN_TERNARY,   // ?
+    TOKEN_SYMBOL,    // b
+    TOKEN_CLOSE,     // :
+    TOKEN_SYMBOL,    // c
+    TOKEN_OP,        // =>
+    TOKEN_SYMBOL,    // c
+  );
+
   _test("let is always keyword in strict", "+let",
     TOKEN_OP,        // +
     TOKEN_KEYWORD,   // let
@@ -757,6 +791,92 @@ int main() {
     TOKEN_CLOSE,     // }
   );
 
+  _test_special(2, SPECIAL__EXTERNAL | SPECIAL__DYNAMIC, "import call", "import('./x.js').then(x)",
+    TOKEN_KEYWORD,   // import
+    TOKEN_PAREN,     // (
+    TOKEN_STRING,    // './x.js'
+    TOKEN_CLOSE,     // )
+    TOKEN_OP,        // .
+    TOKEN_LIT,       // then
+    TOKEN_PAREN,     // (
+    TOKEN_SYMBOL,    // x
+    TOKEN_CLOSE,     // )
+  );
+
+  _test_special(9, SPECIAL__META, "import.meta", "x = new URL('y', import.meta.url)",
+    TOKEN_SYMBOL,    // x
+    TOKEN_OP,        // =
+    TOKEN_OP,        // new
+    TOKEN_SYMBOL,    // URL
+    TOKEN_PAREN,     // (
+    TOKEN_STRING,    // 'y'
+    TOKEN_OP,        // ,
+    TOKEN_KEYWORD,   // import
+    TOKEN_OP,        // .
+    TOKEN_LIT,       // meta
+    TOKEN_OP,        // .
+    TOKEN_LIT,       // url
+    TOKEN_CLOSE,     // )
+  );
+
+  _test_scan(0, "scan module statements", "import x from 'y';\nfoo(/'/, `${x}`)\nexport {x}\nexport * from 'z'",
+    TOKEN_KEYWORD,   // import
+    TOKEN_SYMBOL,    // x
+    TOKEN_KEYWORD,   // from
+    TOKEN_STRING,    // 'y'
+    TOKEN_SEMICOLON, // ;
+    TOKEN_KEYWORD,   // export
+    TOKEN_BRACE,     // {
+    TOKEN_SYMBOL,    // x
+    TOKEN_CLOSE,     // }
+    TOKEN_KEYWORD,   // export
+    TOKEN_OP,        // *
+    TOKEN_KEYWORD,   // from
+    TOKEN_STRING,    // 'z'
+  );
+
+  _test_scan(0, "scan import call", "function f() { return import('./x.js') }\nif (a) { `${import(b)}` }",
+    TOKEN_KEYWORD,   // import
+    TOKEN_PAREN,     // (
+    TOKEN_STRING,    // './x.js'
+    TOKEN_CLOSE,     // )
+    TOKEN_KEYWORD,   // import
+    TOKEN_PAREN,     // (
+    TOKEN_SYMBOL,    // b
+    TOKEN_CLOSE,     // )
+  );
+
+  _test_scan(0, "scan ignores import class method", "class A { import(x) {} }");
+
+  _test_scan(0, "scan ignores import object method", "x = { import(y) {}, async import({z = 1}) {} }");
+
+  _test_scan(0, "scan import call after import method", "class A { import(x) {} f() { import('y') } }",
+    TOKEN_KEYWORD,   // import
+    TOKEN_PAREN,     // (
+    TOKEN_STRING,    // 'y'
+    TOKEN_CLOSE,     // )
+  );
+
+  _test_scan(0, "scan ignores nested keywords", "x = {import: 1, export() {}}; a.export; import.meta");
+
+  _test_scan(0, "scan export declaration", "export const x = 1;",
+    TOKEN_KEYWORD,   // export
+    TOKEN_KEYWORD,   // const
+    TOKEN_SYMBOL,    // x
+    TOKEN_OP,        // =
+    TOKEN_NUMBER,    // 1
+    TOKEN_SEMICOLON, // ;
+  );
+
+  _test_scan(STACK__EXPORT, "scan skips export declaration", "export function foo() { import('x') }\nimport 'y'",
+    TOKEN_KEYWORD,   // import
+    TOKEN_PAREN,     // (
+    TOKEN_STRING,    // 'x'
+    TOKEN_CLOSE,     // )
+    TOKEN_KEYWORD,   // import
+    TOKEN_STRING,    // 'y'
+  );
+
   // restate all errors
   render_output = 1;
   testdef *p = &fail;
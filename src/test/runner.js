@@ -0,0 +1,100 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildHarness, {readRunner} from '../harness/node-harness.js';
+import buildImportsHarness from '../harness/node-imports.js';
+import buildLexer, {RECORD_WORDS} from '../harness/node-lexer.js';
+import {types} from '../harness/common.js';
+import * as fs from 'fs';
+
+import test from 'ava';
+
+const source = `import x from './x.js';
+var y = a / 2 / b;
+export {y};`;
+
+/**
+ * @param {any} harness
+ * @param {boolean} scan
+ * @return {string[]}
+ */
+function tokens(harness, scan = false) {
+  const bytes = new TextEncoder().encode(source);
+  harness.prepare(bytes.length).set(bytes);
+
+  /** @type {string[]} */
+  const out = [];
+  harness.handle({
+    callback() {
+      out.push(harness.token.string());
+    },
+  });
+  scan ? harness.scan() : harness.run();
+  return out;
+}
+
+test('runner fallback', (t) => {
+  const full = readRunner('full');
+  for (const variant of /** @type {const} */ (['imports', 'lexer'])) {
+    const {pathname} = new URL(`../harness/runner-${variant}.wasm`, import.meta.url);
+    if (!fs.existsSync(pathname)) {
+      t.deepEqual(readRunner(variant), full, 'missing variant should fall back to runner.wasm');
+    }
+  }
+});
+
+test('lexer runner', async (t) => {
+  const lexer = await buildLexer();
+  t.deepEqual(tokens(lexer), [
+    'import', 'x', 'from', `'./x.js'`, ';',
+    'var', 'y', '=', 'a', '/', '2', '/', 'b', ';',
+    'export', '{', 'y', '}', ';',
+  ]);
+});
+
+test('imports runner', async (t) => {
+  const full = await buildHarness();
+  const imports = await buildImportsHarness();
+  t.deepEqual(tokens(imports, true), tokens(full, true));
+});
+
+test('lexer tokens', async (t) => {
+  const lexer = await buildLexer();
+  const bytes = new TextEncoder().encode(source);
+  lexer.prepare(bytes.length).set(bytes);
+
+  const out = lexer.tokens();
+  t.is(out.length, RECORD_WORDS * 19);
+
+  // "a / 2" on line two, as location, length, special and line/type (older runners parse, so "a"
+  // may be a symbol rather than a lit)
+  const at = source.indexOf('a / 2');
+  t.deepEqual([...out.subarray(RECORD_WORDS * 8, RECORD_WORDS * 8 + 3)], [at, 1, 0]);
+  t.is(out[RECORD_WORDS * 8 + 3] >> 5, 2);
+  t.true([types.lit, types.symbol].includes(out[RECORD_WORDS * 8 + 3] & 31));
+  t.is(out[RECORD_WORDS * 9], at + 2);
+  t.is(out[RECORD_WORDS * 9 + 3] & 31, types.op);
+
+  // ranges are still relative to the start of the source
+  const range = lexer.tokens(at, at + 5);
+  t.deepEqual([...range].filter((_, i) => i % RECORD_WORDS === 0), [at, at + 2, at + 4]);
+
+  t.throws(() => {
+    const invalid = new TextEncoder().encode('var x = )');
+    lexer.prepare(invalid.length).set(invalid);
+    lexer.tokens();
+  });
+});
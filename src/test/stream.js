@@ -0,0 +1,83 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildHarness from '../harness/node-harness.js';
+import {EVENT_WORDS, EVENT_OPEN, EVENT_CLOSE} from '../harness/replay.js';
+import {encodeStream, decodeStream, streamHash} from '../harness/stream.js';
+
+import test from 'ava';
+
+const source = new TextEncoder().encode(`import x from 'y';
+function foo(a, b = \`\${a}\`) {
+  return a?.b / 2;
+}
+export default foo;`);
+
+// written by gumnut_stream_encode() in "src/lib/stream.c" for the source above
+const expected = Buffer.from(
+  '474d4e5401000000590000002f000000c41ef7574cf8fed6d400000000000000000000000000000029c80300' +
+  '000698c8b68d04a80300010106c80300010480b0ca8904c80200010320400000012a15cc030001080281b0d6' +
+  '9104a803000103122de001000001b0030000012d6800000180e0808204a803000101166800010180e8818204' +
+  '05c002000103a003000001c00200000206a802000001071180040001011dcc03000306028190978d0405a003' +
+  '0001016800000280f8b98404280000010860000101800300010106400000011eac020001010210122e1625cc' +
+  '030001060281a8e28d04c80300010789a0968f0405a003000103400000010626', 'hex');
+
+/**
+ * @param {any} harness
+ * @return {{events: Int32Array, count: number}}
+ */
+function record(harness) {
+  /** @type {number[]} */
+  const out = [];
+  harness.prepare(source.length).set(source);
+  harness.handle({
+    callback() {
+      const {token} = harness;
+      out.push(token.void(), token.at(), token.length(), token.lineNo(), token.type(), token.special());
+    },
+    open(type) {
+      out.push(EVENT_OPEN, type, 0, 0, 0, 0);
+    },
+    close(type) {
+      out.push(EVENT_CLOSE, type, 0, 0, 0, 0);
+    },
+  });
+  harness.run();
+  return {events: Int32Array.from(out), count: out.length / EVENT_WORDS};
+}
+
+test('stream format', async (t) => {
+  const {events, count} = record(await buildHarness());
+
+  const encoded = encodeStream(events, count, source, {ret: 0, scan: false});
+  t.is(Buffer.from(encoded).toString('hex'), expected.toString('hex'));
+
+  const decoded = decodeStream(expected);
+  t.truthy(decoded);
+  t.is(decoded?.count, count);
+  t.is(decoded?.sourceLength, source.length);
+  t.deepEqual(decoded?.events, events);
+
+  const [lo, hi] = streamHash(source);
+  t.is(lo, expected.readUInt32LE(16));
+  t.is(hi, expected.readUInt32LE(20));
+
+  // truncated or corrupt streams fail
+  t.is(decodeStream(expected.subarray(0, expected.length - 1)), null);
+  const corrupt = Buffer.from(expected);
+  corrupt[0] = 0;
+  t.is(decodeStream(corrupt), null);
+});
@@ -22,17 +22,9 @@
 
 #include "../demo/read.c"
 
-void blep_parser_callback() {
-  // ignore
-}
-
-int blep_parser_open(int type) {
-  return 0;
-}
-
-void blep_parser_close(int type) {
-  // ignore
-}
+#ifndef BLEP_VALIDATE
+#error "test262 should be built with -DBLEP_VALIDATE"
+#endif
 
 int main() {
   char *buf;
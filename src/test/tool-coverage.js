@@ -0,0 +1,58 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildCoverageInstrumenter from '../../src/tool/coverage/lib.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+import * as vm from 'vm';
+
+import test from 'ava';
+
+test.serial('coverage', async (t) => {
+  const instrument = await buildCoverageInstrumenter();
+
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const f = path.join(dir, 'source.js');
+  fs.writeFileSync(f, `'use strict';
+function check(x) {
+  if (x) return 1
+  else return 2
+}
+const double = (y) => y * 2
+for (let i = 0; i < 3; ++i) check(i)
+// trailing comment`);
+
+  const decoder = new TextDecoder();
+  let out = '';
+  const map = instrument(f, (part) => {
+    out += decoder.decode(part);
+  });
+
+  t.true(out.startsWith(`'use strict';`), 'directive must remain first');
+  t.deepEqual(map.statements.map(({line}) => line), [3, 3, 4, 6, 7, 7]);
+  t.deepEqual(map.functions.map(({name, line}) => ({name, line})), [
+    {name: 'check', line: 2},
+    {name: '', line: 6},
+  ]);
+
+  const context = vm.createContext({});
+  vm.runInContext(out, context);
+
+  const {s, f: fn} = context.__coverage__[map.path];
+  t.deepEqual(Array.from(s), [3, 2, 1, 1, 1, 3]);
+  t.deepEqual(Array.from(fn), [3, 0]);
+});
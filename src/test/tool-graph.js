@@ -0,0 +1,119 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildModuleGraph from '../../src/tool/graph/lib.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+
+import test from 'ava';
+
+test.serial('module graph', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const write = (name, source) => fs.writeFileSync(path.join(dir, name), source);
+
+  write('entry.js', `import './a.js';\nexport {b} from './b.js';`);
+  write('a.js', `import 'node:fs';`);
+  write('b.js', `export const b = 1;`);
+
+  const {graph, add, update} = await buildModuleGraph(() => (importee) => undefined, {concurrency: 2});
+  const entry = path.join(dir, 'entry.js');
+
+  let delta = await add(entry);
+  t.deepEqual(delta.added.sort(), ['a.js', 'b.js', 'entry.js'].map((f) => path.join(dir, f)));
+
+  const {edges} = /** @type {any} */ (graph.get(entry));
+  t.deepEqual(edges.map(({specifier, kind, line, resolved}) => ({specifier, kind, line, resolved})), [
+    {specifier: './a.js', kind: 'static', line: 1, resolved: path.join(dir, 'a.js')},
+    {specifier: './b.js', kind: 'reexport', line: 2, resolved: path.join(dir, 'b.js')},
+  ]);
+  t.is(graph.get(path.join(dir, 'a.js'))?.edges[0].resolved, null);
+  t.deepEqual([...graph.get(path.join(dir, 'b.js'))?.importers ?? []], [entry]);
+
+  // swap b.js for c.js
+  write('entry.js', `import './a.js';\nimport './c.js';`);
+  write('c.js', ``);
+  delta = await update(entry);
+  t.deepEqual(delta, {
+    added: [path.join(dir, 'c.js')],
+    removed: [path.join(dir, 'b.js')],
+    changed: [entry],
+  });
+  t.deepEqual([...graph.get(path.join(dir, 'c.js'))?.importers ?? []], [entry]);
+
+  fs.rmSync(dir, {recursive: true});
+});
+
+test.serial('module graph concurrency', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const write = (name, source) => fs.writeFileSync(path.join(dir, name), source);
+
+  // Loads finish while others wait and as more are added. Besides the entry, every file has one
+  // import, so the number of resolvers running is the number of loads.
+  const entry = path.join(dir, 'entry.js');
+  write('entry.js', [...Array(16)].map((_, i) => `import './c${i}.js';`).join('\n'));
+  for (let i = 0; i < 16; ++i) {
+    write(`c${i}.js`, `import './g${i}.js';`);
+    write(`g${i}.js`, `import 'leaf';`);
+  }
+
+  let active = 0;
+  let max = 0;
+  const {graph, add} = await buildModuleGraph((importer) => async () => {
+    if (importer === entry) {
+      return undefined;
+    }
+    max = Math.max(max, ++active);
+    await new Promise((r) => setTimeout(r, Math.random() * 4));
+    --active;
+    return undefined;
+  }, {concurrency: 3});
+
+  await add(entry);
+  t.is(graph.size, 1 + 16 * 2);
+  t.true(max <= 3, `max was ${max}`);
+
+  fs.rmSync(dir, {recursive: true});
+});
+
+test.serial('module graph exports', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const write = (name, source) => fs.writeFileSync(path.join(dir, name), source);
+
+  const entry = path.join(dir, 'entry.js');
+  write('entry.js', `import {a} from './a.js';
+export default a;
+export function load() { return import('./b.js'); }
+export * from './c.js';
+const x = () => import('./d.js');
+export {x as y};`);
+  ['a.js', 'b.js', 'c.js', 'd.js'].forEach((f) => write(f, ``));
+
+  const edges = (graph) => graph.get(entry).edges.map(({specifier, kind, line}) => ({specifier, kind, line}));
+
+  const plain = await buildModuleGraph(() => (importee) => undefined);
+  await plain.add(entry);
+  t.is(/** @type {any} */ (plain.graph.get(entry)).exports, undefined);
+
+  // the same edges are found when exports are, from one parse
+  const withExports = await buildModuleGraph(() => (importee) => undefined, {exports: true});
+  await withExports.add(entry);
+  t.deepEqual(edges(withExports.graph), edges(plain.graph));
+  t.deepEqual(/** @type {any} */ (withExports.graph.get(entry)).exports, ['default', 'load', '*', 'y']);
+  t.deepEqual(/** @type {any} */ (withExports.graph.get(path.join(dir, 'a.js'))).exports, []);
+
+  fs.rmSync(dir, {recursive: true});
+});
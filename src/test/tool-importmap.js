@@ -0,0 +1,72 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildImportMapper from '../../src/tool/importmap/lib.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+
+import test from 'ava';
+
+test.serial('import map', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const write = (name, source) => {
+    fs.mkdirSync(path.dirname(path.join(dir, name)), {recursive: true});
+    fs.writeFileSync(path.join(dir, name), source);
+  };
+
+  write('package.json', '{}');
+  write('src/entry.js', `import 'foo';\nimport './util';`);
+  write('src/util.js', ``);
+  write('node_modules/foo/package.json', '{}');
+  write('node_modules/foo/index.js', `export * from 'bar';`);
+  write('node_modules/foo/node_modules/bar/package.json', '{}');
+  write('node_modules/foo/node_modules/bar/index.js', ``);
+
+  // finds packages in the closest node_modules, and adds missing ".js"
+  const buildResolver = (importer) => (importee) => {
+    if (importee.startsWith('.')) {
+      return importee.endsWith('.js') ? undefined : importee + '.js';
+    }
+    let check = path.dirname(importer);
+    for (;;) {
+      const candidate = path.join(check, 'node_modules', importee, 'index.js');
+      if (fs.existsSync(candidate)) {
+        return './' + path.relative(path.dirname(importer), candidate);
+      }
+      check = path.dirname(check);
+    }
+  };
+
+  const {importmap} = buildImportMapper(buildResolver, {root: dir});
+  const map = await importmap('src/entry.js');
+  t.deepEqual(map, {
+    imports: {
+      'foo': '/node_modules/foo/index.js',
+      '/src/util': '/src/util.js',
+    },
+    scopes: {
+      '/node_modules/foo/': {'bar': '/node_modules/foo/node_modules/bar/index.js'},
+    },
+  });
+
+  t.is(await importmap('src/entry.js'), map, 'should be cached');
+
+  write('package.json', '{"dependencies": {}}');
+  t.not(await importmap('src/entry.js'), map, 'should regenerate after manifest change');
+
+  fs.rmSync(dir, {recursive: true});
+});
@@ -14,7 +14,10 @@
  * the License.
  */
 
-import buildImportsRewriter from '../../src/tool/imports/lib.js';
+import buildImportsRewriter, {buildRewriteCache} from '../../src/tool/imports/lib.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
 
 import test from 'ava';
 
@@ -34,3 +37,99 @@ test.serial('imports rewriter', async (t) => {
   t.is(out, 'import "lol";');
 });
 
+
+test.serial('imports rewriter cache', async (t) => {
+  let resolved = 'lol';
+  const rewrite = await buildImportsRewriter((f) => {
+    return () => resolved;
+  });
+
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const f = path.join(dir, 'source.js');
+  fs.writeFileSync(f, `import './real-path';`);
+
+  let state = 'a';
+  const cache = buildRewriteCache(rewrite, {resolverKey: (f) => f + state});
+
+  const decoder = new TextDecoder();
+  const runToString = () => {
+    let out = '';
+    cache.run(f, (part) => {
+      out += decoder.decode(part);
+    });
+    return out;
+  };
+
+  t.is(runToString(), 'import "lol";');
+  resolved = 'ignored';
+  t.is(runToString(), 'import "lol";');
+  t.is(cache.stats().hits, 1);
+  t.is(cache.stats().unread, 1);
+
+  // a change in resolver state is a miss
+  state = 'b';
+  t.is(runToString(), 'import "ignored";');
+
+  // as is a change in content
+  fs.writeFileSync(f, `import './other-path'; // changed`);
+  t.is(runToString(), 'import "ignored"; // changed');
+
+  const stats = cache.stats();
+  t.is(stats.misses, 3);
+  t.is(stats.hitRate, 0.25);
+
+  fs.rmSync(dir, {recursive: true});
+});
+
+test.serial('imports rewriter cache manifests', async (t) => {
+  const rewrite = await buildImportsRewriter((f) => () => 'lol');
+
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const f = path.join(dir, 'source.js');
+  fs.writeFileSync(f, `import 'dep';`);
+  fs.writeFileSync(path.join(dir, 'package.json'), '{}');
+
+  const cache = buildRewriteCache(rewrite, {manifestTtlMs: 0});
+  const lazy = buildRewriteCache(rewrite, {manifestTtlMs: 60 * 1000});
+  for (const c of [cache, lazy]) {
+    c.run(f, () => {});
+    c.run(f, () => {});
+    t.is(c.stats().hits, 1);
+  }
+
+  // a changed manifest or new lockfile is a miss
+  fs.writeFileSync(path.join(dir, 'package.json'), '{"dependencies": {"dep": "1"}}');
+  cache.run(f, () => {});
+  fs.writeFileSync(path.join(dir, 'package-lock.json'), '{}');
+  cache.run(f, () => {});
+  t.is(cache.stats().misses, 3);
+
+  // ... unless the manifests were checked within the TTL
+  lazy.run(f, () => {});
+  t.is(lazy.stats().misses, 1);
+
+  fs.rmSync(dir, {recursive: true});
+});
+
+test.serial('imports rewriter cache dir eviction', async (t) => {
+  const rewrite = await buildImportsRewriter((f) => () => 'lol');
+
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const cacheDir = path.join(dir, 'cache');
+  const cache = buildRewriteCache(rewrite, {dir: cacheDir, dirMaxBytes: 4096});
+
+  const f = path.join(dir, 'source.js');
+  for (let i = 0; i < 64; ++i) {
+    fs.writeFileSync(f, `import './a.js';\nvar unique${i} = '${'x'.repeat(200)}';`);
+    cache.run(f, () => {});
+  }
+  t.true(cache.stats().evicted > 0);
+
+  let total = 0;
+  for (const name of fs.readdirSync(cacheDir)) {
+    total += fs.statSync(path.join(cacheDir, name)).size;
+  }
+  t.true(total <= 4096 + 4096 / 8 + 512, `directory was ${total} bytes`);
+
+  fs.rmSync(dir, {recursive: true});
+});
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildMinifier from '../../src/tool/minify/lib.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+
+import test from 'ava';
+
+const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+const decoder = new TextDecoder();
+
+/**
+ * @param {(file: string, write: (part: Uint8Array) => void) => void} minify
+ * @param {string} source
+ */
+const minifyString = (minify, source) => {
+  const f = path.join(dir, 'source.js');
+  fs.writeFileSync(f, source);
+
+  let out = '';
+  minify(f, (part) => {
+    out += decoder.decode(part);
+  });
+  return out;
+};
+
+test.serial('minify', async (t) => {
+  const minify = await buildMinifier();
+
+  t.is(minifyString(minify, `#!/usr/bin/env node
+// comment
+import foo from 'bar';  /* trailing */
+
+const x = a
+++b
+let y = x + +1, z = x - -1
+var q = 1 .toString() / /re/g
+return
+`), `#!/usr/bin/env node
+import foo from'bar';const x=a
+++b
+let y=x+ +1,z=x- -1
+var q=1 .toString()/ /re/g
+return`);
+
+  t.is(minifyString(minify, `
+function f() {
+  return {
+    a: 1,
+    b: [
+      2,
+      3
+    ]
+  }
+}
+`), `function f(){return{a:1,b:[2,3]}}`);
+
+  // the operand of yield can't follow a newline
+  t.is(minifyString(minify, `function* g() {
+  yield
+  x
+  yield x
+}`), `function*g(){yield
+x
+yield x}`);
+});
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildImportUsage, {findUnusedReexports} from '../../src/tool/unused/lib.js';
+import buildModuleGraph from '../../src/tool/graph/lib.js';
+import * as fs from 'fs';
+import * as os from 'os';
+import * as path from 'path';
+
+import test from 'ava';
+
+const encoder = new TextEncoder();
+
+test.serial('unused imports', async (t) => {
+  const usage = await buildImportUsage();
+
+  const bindings = usage(encoder.encode(`
+import def, {a as b, c, unused} from 'x';
+import * as ns from 'y';
+b(c.unused, {def});
+export {ns};
+`));
+
+  t.deepEqual(bindings.map(({local, imported, specifier, references}) => ({local, imported, specifier, references})), [
+    {local: 'def', imported: 'default', specifier: 'x', references: 1},
+    {local: 'b', imported: 'a', specifier: 'x', references: 1},
+    {local: 'c', imported: 'c', specifier: 'x', references: 1},
+    {local: 'unused', imported: 'unused', specifier: 'x', references: 0},
+    {local: 'ns', imported: '*', specifier: 'y', references: 1},
+  ]);
+});
+
+test.serial('unused reexports', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const write = (name, source) => fs.writeFileSync(path.join(dir, name), source);
+
+  write('entry.js', `import {used} from './lib.js';\nexport {entryOnly} from './lib.js';`);
+  write('lib.js', `export {used, unused} from './impl.js';\nexport {entryOnly} from './impl.js';`);
+  write('impl.js', `export const used = 1, unused = 2, entryOnly = 3;`);
+
+  const {graph, entries, add} = await buildModuleGraph(() => () => undefined);
+  await add(path.join(dir, 'entry.js'));
+
+  const unused = findUnusedReexports(graph, entries);
+  t.deepEqual(unused.map(({file, name, line}) => ({file, name, line})), [
+    {file: path.join(dir, 'lib.js'), name: 'unused', line: 1},
+  ]);
+
+  fs.rmSync(dir, {recursive: true});
+});
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import buildWatcher from '../../src/tool/watch/lib.js';
+import * as fs from 'fs';
+import * as net from 'net';
+import * as os from 'os';
+import * as path from 'path';
+
+import test from 'ava';
+
+test.serial('watcher', async (t) => {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'gumnut-'));
+  const write = (name, source) => fs.writeFileSync(path.join(dir, name), source);
+  const entry = path.join(dir, 'entry.js');
+  const socket = path.join(dir, 'watch.sock');
+
+  write('entry.js', `import {a} from './a.js';\nexport const b = a;`);
+  write('a.js', `export const a = 1;`);
+
+  const rewrite = (f, w) => w(fs.readFileSync(f));
+  const watcher = await buildWatcher(() => (importee) => undefined, {rewrite, socket, debounce: 5});
+  await watcher.add(entry);
+
+  t.deepEqual(watcher.module(entry), {
+    imports: [{specifier: './a.js', kind: 'static', resolved: path.join(dir, 'a.js')}],
+    exports: ['b'],
+  });
+  t.is(new TextDecoder().decode(watcher.output(entry)), fs.readFileSync(entry, 'utf-8'));
+
+  // subscribers get the current graph, then deltas
+  const conn = net.connect(socket);
+  /** @type {any[]} */
+  const lines = [];
+  let buffer = '';
+  /** @type {() => void} */
+  let notify = () => {};
+  conn.on('data', (data) => {
+    buffer += data.toString();
+    const parts = buffer.split('\n');
+    buffer = /** @type {string} */ (parts.pop());
+    lines.push(...parts.map((line) => JSON.parse(line)));
+    notify();
+  });
+  const nextLine = async () => {
+    while (!lines.length) {
+      await new Promise((r) => notify = /** @type {() => void} */ (r));
+    }
+    return lines.shift();
+  };
+
+  const initial = await nextLine();
+  t.deepEqual(initial.added.sort(), [path.join(dir, 'a.js'), entry]);
+
+  write('a.js', `export const a = 1;\nexport * from './c.js';`);
+  write('c.js', `export function c() {}`);
+  const delta = await nextLine();
+  t.deepEqual(delta.added, [path.join(dir, 'c.js')]);
+  t.deepEqual(delta.changed, [path.join(dir, 'a.js')]);
+  t.deepEqual(delta.modules[path.join(dir, 'a.js')].exports, ['a', '*']);
+  t.deepEqual(delta.modules[path.join(dir, 'c.js')].exports, ['c']);
+
+  // output is refreshed after a change
+  write('entry.js', `export const b = 2;`);
+  const removed = await nextLine();
+  t.deepEqual(removed.changed, [entry]);
+  t.deepEqual(removed.removed.sort(), [path.join(dir, 'a.js'), path.join(dir, 'c.js')]);
+  t.is(new TextDecoder().decode(watcher.output(entry)), `export const b = 2;`);
+
+  conn.destroy();
+  watcher.close();
+  fs.rmSync(dir, {recursive: true});
+});
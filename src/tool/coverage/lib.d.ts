@@ -0,0 +1,40 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+export interface CoverageRange {
+  /** Offset of the first token. */
+  at: number;
+  /** Offset after the last token. */
+  end: number;
+  line: number;
+}
+
+export interface CoverageMap {
+  /** Absolute path, which is also the key in `globalThis.__coverage__`. */
+  path: string;
+  /** Name of the counter variable within the instrumented source. */
+  name: string;
+  /** Indexed the same as the `s` array of counts. */
+  statements: CoverageRange[];
+  /** Indexed the same as the `f` array of counts. Names are empty for anonymous functions. */
+  functions: (CoverageRange & {name: string})[];
+}
+
+/**
+ * Builds an instrumenter which rewrites a passed file to count statement and function executions
+ * into `globalThis.__coverage__[path]`, returning the map of what each count refers to.
+ */
+export default function buildCoverageInstrumenter(): Promise<(file: string, write: (part: Uint8Array) => void) => CoverageMap>;
@@ -0,0 +1,316 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Instruments JS for statement and function coverage in a single pass, using only
+ * the stacks announced by the parser.
+ */
+
+import * as path from 'path';
+import * as crypto from 'crypto';
+import * as common from '../../harness/common.js';
+import buildHarness from '../../harness/node-harness.js';
+import rewriter from '../../harness/node-rewriter.js';
+
+/**
+ * @typedef {{
+ *   at: number,
+ *   end: number,
+ *   line: number,
+ * }} CoverageRange
+ *
+ * @typedef {{
+ *   path: string,
+ *   name: string,
+ *   statements: CoverageRange[],
+ *   functions: (CoverageRange & {name: string})[],
+ * }} CoverageMap
+ *
+ * @typedef {{
+ *   type: number,
+ *   parent?: Frame,
+ *   fn?: Frame,
+ *   index: number,
+ *   depth: number,
+ *   arrow: number,
+ *   range?: CoverageRange,
+ *   entry: string,
+ *   closeInsert: string,
+ *   statements: number,
+ * }} Frame
+ */
+
+// Statements which can be counted, if they're directly within a block or at the top-level.
+const statementStacks = new Set([
+  common.stacks.expr,
+  common.stacks.declare,
+  common.stacks.control,
+  common.stacks.misc,
+  common.stacks.label,
+  common.stacks.class,
+]);
+
+// These can't be counted or wrapped under a control, as they're part of the previous statement.
+const continuationKeywords = new Set([
+  common.lit.ELSE,
+  common.lit.CATCH,
+  common.lit.FINALLY,
+  common.lit.CASE,
+  common.lit.DEFAULT,
+]);
+
+const ARROW_BODY_NONE = 0;
+const ARROW_BODY_PENDING = 1;
+const ARROW_BODY_STARTED = 2;
+
+/**
+ * Builds an instrumenter which rewrites a file to count statement and function executions into
+ * `globalThis.__coverage__[path]`, as `{path, s, f}` arrays of counts.
+ *
+ * Statements directly within a block or at the top-level are prefixed with a counter, and those
+ * directly under a control (e.g., `if (x) foo();`) are additionally wrapped in a block. Functions
+ * count on entry, and arrow functions with expression bodies become a comma expression.
+ *
+ * @return {Promise<(file: string, write: (part: Uint8Array) => void) => CoverageMap>}
+ */
+export default async function buildCoverageInstrumenter() {
+  const harness = await buildHarness();
+  const {token, run} = rewriter(harness);
+
+  return (f, write) => {
+    const absolute = path.resolve(f);
+    const name = '__cov_' + crypto.createHash('sha256').update(absolute).digest('hex').substr(0, 8);
+    const pathLiteral = JSON.stringify(absolute);
+
+    /** @type {CoverageMap} */
+    const map = {path: absolute, name, statements: [], functions: []};
+
+    /** @type {Frame} */
+    const root = {type: 0, index: -1, depth: 0, arrow: ARROW_BODY_NONE, entry: `var ${name}=${name}_init();`, closeInsert: '', statements: 0};
+    let frame = root;
+
+    /** @type {Frame[]} */
+    let awaiting = [];
+    let pendingPrefix = '';
+    let lastEnd = 0;
+
+    /**
+     * @param {Frame} target
+     * @return {number} index of the function containing this frame
+     */
+    const fnIndex = (target) => /** @type {Frame} */ (target.fn).index;
+
+    /**
+     * Allocates a counter for a statement, returning its prefix.
+     *
+     * @param {Frame} target
+     * @param {boolean} wrap
+     * @return {string}
+     */
+    const countStatement = (target, wrap) => {
+      target.range = {at: token.at(), end: token.at(), line: token.lineNo()};
+      target.index = map.statements.push(target.range) - 1;
+      const inc = `${name}.s[${target.index}]++;`;
+      if (wrap) {
+        target.closeInsert = '}';
+        return '{' + inc;
+      }
+      return inc;
+    };
+
+    /**
+     * Called on the first token inside a frame, which may be within a deeper frame.
+     *
+     * @param {Frame} target
+     * @return {string} prefix to insert before this token
+     */
+    const start = (target) => {
+      const parent = /** @type {Frame} */ (target.parent);
+
+      if (target.type === common.stacks.function) {
+        target.range = {at: token.at(), end: token.at(), line: token.lineNo()};
+        target.index = map.functions.push({...target.range, name: ''}) - 1;
+      }
+
+      // Anything at the start of a function body or the top-level flushes its entry, unless it
+      // might be a directive (e.g., "use strict"), which must remain first.
+      const isDirective = !parent.statements++ && target.type === common.stacks.expr &&
+          token.type() === common.types.string;
+      let prefix = '';
+      if (parent.entry) {
+        if (isDirective) {
+          target.closeInsert = ';' + parent.entry;
+        } else {
+          prefix = parent.entry;
+        }
+        parent.entry = '';
+      }
+      if (isDirective || !statementStacks.has(target.type)) {
+        return prefix;
+      }
+
+      const under = parent.type;
+      if (under === common.stacks.control) {
+        if (parent.depth) {
+          return prefix;  // within the control's head, e.g. "for (let i...)"
+        }
+      } else if (under !== common.stacks.block && under !== 0) {
+        return prefix;
+      }
+
+      if (continuationKeywords.has(token.special()) && token.type() === common.types.keyword) {
+        return prefix;
+      }
+
+      if (under === common.stacks.control) {
+        // Don't wrap controls or classes, as "else" might follow, or hoisting might change.
+        if (target.type === common.stacks.control || target.type === common.stacks.class) {
+          return prefix;
+        }
+        return prefix + countStatement(target, true);
+      }
+      // nb. the entry ends with ";", otherwise guard against the previous statement
+      return (prefix || ';') + countStatement(target, false);
+    };
+
+    /** @type {Partial<import('../../harness/types/index.js').RewriterArgs>} */
+    const args = {
+      write,
+
+      stack(type) {
+        if (type === 0) {
+          return;  // closes are handled below
+        }
+
+        /** @type {Frame} */
+        // nb. functions are only numbered on their first token, so refer to the frame
+        const next = {type, parent: frame, fn: frame.fn, index: -1, depth: 0, arrow: ARROW_BODY_NONE, entry: '', closeInsert: '', statements: 0};
+
+        if (frame.arrow === ARROW_BODY_PENDING) {
+          frame.arrow = ARROW_BODY_STARTED;
+          if (type !== common.stacks.block) {
+            pendingPrefix += `(${name}.f[${fnIndex(frame)}]++,`;
+            frame.closeInsert = ')';
+          }
+        }
+
+        if (type === common.stacks.function) {
+          next.fn = next;
+        }
+        frame = next;
+        awaiting.push(next);
+      },
+
+      close() {
+        const prev = frame;
+        frame = /** @type {Frame} */ (prev.parent);
+
+        if (prev.range) {
+          prev.range.end = lastEnd;
+        }
+        if (prev.type === common.stacks.function) {
+          map.functions[prev.index].end = lastEnd;
+        }
+
+        const insert = prev.entry + prev.closeInsert;
+        if (insert) {
+          return insert;
+        }
+      },
+
+      callback() {
+        let prefix = '';
+        for (const target of awaiting) {
+          prefix += start(target);
+        }
+        awaiting = [];
+
+        const type = token.type();
+
+        switch (frame.type) {
+          case common.stacks.function:
+            if (type === common.types.symbol && !map.functions[frame.index].name) {
+              map.functions[frame.index].name = token.string();
+            }
+            break;
+
+          case common.stacks.inner:
+            if (frame.parent?.type !== common.stacks.function) {
+              break;
+            }
+            if (frame.arrow === ARROW_BODY_PENDING) {
+              frame.arrow = ARROW_BODY_STARTED;
+              prefix += `(${name}.f[${fnIndex(frame)}]++,`;
+              frame.closeInsert = ')';
+            } else if (frame.arrow === ARROW_BODY_NONE && type === common.types.op && token.special() === common.lit.$ARROW) {
+              // nb. older parsers may announce later arrows without their own stack, ignore them
+              frame.arrow = ARROW_BODY_PENDING;
+            }
+            break;
+
+          case common.stacks.block:
+            if (frame.parent?.type === common.stacks.inner && frame.parent.parent?.type === common.stacks.function && type === common.types.block) {
+              // the opening "{" of a function body, count on the next statement or close
+              frame.entry = `${name}.f[${fnIndex(frame)}]++;`;
+              break;
+            }
+            if (type === common.types.close && frame.entry) {
+              prefix += frame.entry;  // empty function body
+              frame.entry = '';
+            }
+            break;
+
+          case common.stacks.control:
+            switch (type) {
+              case common.types.paren:
+              case common.types.array:
+              case common.types.brace:
+              case common.types.ternary:
+                ++frame.depth;
+                break;
+              case common.types.close:
+                --frame.depth;
+                break;
+            }
+            break;
+        }
+
+        prefix += pendingPrefix;
+        pendingPrefix = '';
+
+        const length = token.length();
+        if (length) {
+          lastEnd = token.at() + length;
+        }
+
+        if (prefix) {
+          return prefix + token.string();
+        }
+      },
+    };
+
+    run(f, args);
+
+    // An empty file never writes the entry. Initialization is hoisted so it's valid at the end.
+    write(new TextEncoder().encode(`${root.entry ? '\n' + root.entry : ''}
+;function ${name}_init(){var g=globalThis,c=g.__coverage__=g.__coverage__||{};` +
+        `return c[${pathLiteral}]=c[${pathLiteral}]||{path:${pathLiteral},` +
+        `s:new Array(${map.statements.length}).fill(0),f:new Array(${map.functions.length}).fill(0)}}
+`));
+
+    return map;
+  };
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * Names taken from another module. For imports, `local` is the new binding. For reexports, `local`
+ * is the name exported from this module. Namespaces and `export *` use the name "*".
+ */
+export interface ModuleName {
+  imported: string;
+  local: string;
+}
+
+export interface ModuleEdge {
+  specifier: string;
+  kind: 'static' | 'dynamic' | 'reexport';
+  names: ModuleName[];
+
+  /** Byte offset of the specifier string (including its quotes). */
+  at: number;
+  length: number;
+  line: number;
+
+  /** Absolute path of the target, or null if this is not a path (e.g., "node:fs"). */
+  resolved: string | null;
+}
+
+export interface ModuleNode {
+  edges: ModuleEdge[];
+  importers: Set<string>;
+
+  /** Exported names, including "default", and "*" for `export * from`. Set if built with `exports`. */
+  exports?: string[];
+
+  /** Set if this file could not be read or parsed. */
+  error?: Error;
+}
+
+export interface GraphDelta {
+  added: string[];
+  removed: string[];
+  changed: string[];
+}
+
+export function isRelative(specifier: string): boolean;
+
+/**
+ * Builds a module graph, which is crawled from entrypoints passed to `add`. Files are read and
+ * resolved with bounded concurrency.
+ */
+export default function buildModuleGraph(
+  buildResolver: (importer: string) => ((importee: string) => string | undefined | Promise<string | undefined>),
+  options?: {concurrency?: number, exports?: boolean},
+): Promise<{
+  graph: Map<string, ModuleNode>;
+  entries: Set<string>;
+  add(...files: string[]): Promise<GraphDelta>;
+  update(...files: string[]): Promise<GraphDelta>;
+}>;
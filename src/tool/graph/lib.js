@@ -0,0 +1,242 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Builds and incrementally updates the module graph reachable from entrypoints.
+ *
+ * Files are read and resolved concurrently, but each is parsed synchronously by one harness.
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+import buildHarness from '../../harness/node-harness.js';
+import buildModuleReader from './module.js';
+
+const DEFAULT_CONCURRENCY = 8;
+
+/**
+ * @typedef {import('./module.js').ModuleImport & {resolved: string?}} ModuleEdge
+ *
+ * @typedef {{
+ *   edges: ModuleEdge[],
+ *   importers: Set<string>,
+ *   exports?: string[],
+ *   error?: Error,
+ * }} ModuleNode
+ *
+ * @typedef {{
+ *   added: string[],
+ *   removed: string[],
+ *   changed: string[],
+ * }} GraphDelta
+ */
+
+/**
+ * @param {string} specifier
+ * @return {boolean}
+ */
+export function isRelative(specifier) {
+  return specifier.startsWith('./') || specifier.startsWith('../') || specifier.startsWith('/');
+}
+
+/**
+ * Builds a module graph, which is crawled from entrypoints passed to `add`.
+ *
+ * The resolver has the same shape as the imports rewriter, but may be async. Specifiers it returns
+ * (or those it ignores) are followed if they are relative or absolute paths. Others, such as
+ * `node:fs`, are recorded as edges with a null `resolved` target.
+ *
+ * Pass `exports` to also record the exported names of each module, found in the same parse.
+ *
+ * @param {(importer: string) => (importee: string) => string|undefined|Promise<string|undefined>} buildResolver
+ * @param {{concurrency?: number, exports?: boolean}=} options
+ */
+export default async function buildModuleGraph(buildResolver, {
+  concurrency = DEFAULT_CONCURRENCY,
+  exports = false,
+} = {}) {
+  const harness = await buildHarness();
+  const read = buildModuleReader(harness, {exports});
+
+  /** @type {Map<string, ModuleNode>} */
+  const graph = new Map();
+
+  /** @type {Set<string>} */
+  const entries = new Set();
+
+  let active = 0;
+  /** @type {(() => void)[]} */
+  const waiting = [];
+
+  /**
+   * Reads, parses and resolves a single file, bounded by the concurrency limit.
+   *
+   * @param {string} f
+   * @return {Promise<ModuleNode>}
+   */
+  const load = async (f) => {
+    if (active >= concurrency) {
+      // the slot is handed over by the load which frees it, so active never drops in between
+      await new Promise((r) => waiting.push(r));
+    } else {
+      ++active;
+    }
+
+    /** @type {ModuleNode} */
+    const node = {edges: [], importers: graph.get(f)?.importers ?? new Set()};
+    try {
+      const source = await fs.promises.readFile(f);
+      const {imports, exports: names} = read(source);
+      if (names) {
+        node.exports = names;
+      }
+
+      const resolver = buildResolver(f);
+      const dir = path.dirname(f);
+      node.edges = await Promise.all(imports.map(async (imp) => {
+        const out = (await resolver(imp.specifier)) ?? imp.specifier;
+        const resolved = isRelative(out) ? path.resolve(dir, out) : null;
+        return {...imp, resolved};
+      }));
+    } catch (e) {
+      node.error = /** @type {Error} */ (e);
+    } finally {
+      const next = waiting.shift();
+      if (next) {
+        next();
+      } else {
+        --active;
+      }
+    }
+
+    return node;
+  };
+
+  /**
+   * Loads the passed files and anything newly reachable from them.
+   *
+   * @param {string[]} files
+   * @param {GraphDelta} delta
+   */
+  const crawl = async (files, delta) => {
+    /**
+     * @param {string} f
+     * @param {boolean} isNew
+     * @return {Promise<void>}
+     */
+    const visit = async (f, isNew) => {
+      const prev = graph.get(f);
+      const node = await load(f);
+      graph.set(f, node);
+
+      if (isNew) {
+        delta.added.push(f);
+      } else if (prev) {
+        delta.changed.push(f);
+        for (const edge of prev.edges) {
+          edge.resolved && graph.get(edge.resolved)?.importers.delete(f);
+        }
+      }
+
+      const pending = [];
+      for (const edge of node.edges) {
+        if (!edge.resolved) {
+          continue;
+        }
+        const target = graph.get(edge.resolved);
+        if (target) {
+          target.importers.add(f);
+          continue;
+        }
+
+        // reserve this target so it's only visited once
+        graph.set(edge.resolved, {edges: [], importers: new Set([f])});
+        pending.push(visit(edge.resolved, true));
+      }
+      await Promise.all(pending);
+    };
+
+    await Promise.all(files.map((f) => visit(f, !graph.has(f))));
+  };
+
+  /**
+   * Removes modules which are no longer reachable from any entrypoint.
+   *
+   * @param {GraphDelta} delta
+   */
+  const collect = (delta) => {
+    /** @type {Set<string>} */
+    const reachable = new Set();
+    const pending = [...entries];
+    while (pending.length) {
+      const f = /** @type {string} */ (pending.pop());
+      if (reachable.has(f)) {
+        continue;
+      }
+      reachable.add(f);
+      for (const edge of graph.get(f)?.edges ?? []) {
+        edge.resolved && pending.push(edge.resolved);
+      }
+    }
+
+    for (const [f, node] of graph) {
+      if (reachable.has(f)) {
+        continue;
+      }
+      graph.delete(f);
+      delta.removed.push(f);
+      for (const edge of node.edges) {
+        edge.resolved && graph.get(edge.resolved)?.importers.delete(f);
+      }
+    }
+  };
+
+  return {
+    graph,
+    entries,
+
+    /**
+     * Adds entrypoints to the graph, crawling any new modules.
+     *
+     * @param {...string} files
+     * @return {Promise<GraphDelta>}
+     */
+    async add(...files) {
+      /** @type {GraphDelta} */
+      const delta = {added: [], removed: [], changed: []};
+      files = files.map((f) => path.resolve(f));
+      files.forEach((f) => entries.add(f));
+      await crawl(files.filter((f) => !graph.has(f)), delta);
+      return delta;
+    },
+
+    /**
+     * Re-reads the passed files, which have changed, and updates the graph. Files not already in
+     * the graph are ignored.
+     *
+     * @param {...string} files
+     * @return {Promise<GraphDelta>}
+     */
+    async update(...files) {
+      /** @type {GraphDelta} */
+      const delta = {added: [], removed: [], changed: []};
+      files = files.map((f) => path.resolve(f)).filter((f) => graph.has(f));
+      await crawl(files, delta);
+      collect(delta);
+      return delta;
+    },
+  };
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Extracts the imports (and optionally exports) of a single module, via the harness'
+ * scanner.
+ */
+
+import * as blep from '../../harness/types/index.js';
+import * as common from '../../harness/common.js';
+import {buildSummary} from '../../harness/parse-cache.js';
+
+/**
+ * Names taken from another module. For imports, `local` is the new binding. For reexports, `local`
+ * is the name exported from this module. Namespaces and `export *` use the name "*".
+ *
+ * @typedef {{imported: string, local: string}} ModuleName
+ *
+ * @typedef {{
+ *   specifier: string,
+ *   kind: 'static'|'dynamic'|'reexport',
+ *   names: ModuleName[],
+ *   at: number,
+ *   length: number,
+ *   line: number,
+ * }} ModuleImport
+ *
+ * @typedef {{
+ *   imports: ModuleImport[],
+ *   exports?: string[],
+ * }} ModuleRead
+ */
+
+/**
+ * Builds a reader which finds the imports of passed source. The harness is not reentrant, so this
+ * must not be called from within other handlers.
+ *
+ * Pass `exports` to also find exported names in the same scan. This parses export declarations
+ * rather than skipping them, but imports within them are still ignored, so the imports found don't
+ * depend on this option.
+ *
+ * @param {blep.Harness} harness
+ * @param {{exports?: boolean}=} options
+ * @return {(source: Uint8Array) => ModuleRead}
+ */
+export default function buildModuleReader(harness, {exports = false} = {}) {
+  const {token} = harness;
+
+  return (source) => {
+    const memory = harness.prepare(source.length);
+    memory.set(source);
+
+    /** @type {ModuleImport[]} */
+    const out = [];
+
+    const summary = exports ? buildSummary(token) : null;
+    let exportDepth = 0;
+
+    // depth of open stacks, and the depth of the module statement being read (or -1)
+    let depth = 0;
+    let moduleDepth = -1;
+
+    /** @type {ModuleImport['kind']} */
+    let kind = 'static';
+    let index = 0;
+
+    /** @type {ModuleName[]} */
+    let names = [];
+
+    /** @type {string?} */
+    let pending = null;
+
+    const flush = () => {
+      if (pending !== null) {
+        names.push({imported: pending, local: pending});
+        pending = null;
+      }
+    };
+
+    harness.handle({
+      open(type) {
+        if (summary) {
+          summary.handlers.open(type);
+          if (type === common.stacks.export) {
+            ++exportDepth;
+          }
+        } else if (type !== common.stacks.module) {
+          return false;
+        }
+
+        ++depth;
+        if (type === common.stacks.module && moduleDepth === -1 && !exportDepth) {
+          moduleDepth = depth;
+          index = 0;
+          names = [];
+          pending = null;
+        }
+      },
+
+      close(type) {
+        if (summary) {
+          summary.handlers.close(type);
+          if (type === common.stacks.export) {
+            --exportDepth;
+          }
+        }
+        if (depth-- === moduleDepth) {
+          moduleDepth = -1;
+        }
+      },
+
+      callback() {
+        summary?.handlers.callback();
+        if (depth !== moduleDepth) {
+          return;
+        }
+
+        const type = token.type();
+        const special = token.special();
+
+        switch (index++) {
+          case 0:
+            kind = special === common.lit.EXPORT ? 'reexport' : 'static';
+            return;
+
+          case 1:
+            if (kind === 'static' && type === common.types.paren) {
+              kind = 'dynamic';
+              names.push({imported: '*', local: ''});
+            }
+            break;
+        }
+
+        switch (type) {
+          case common.types.op:
+            if (special === common.lit.$STAR) {
+              pending = '*';
+            } else if (special === common.lit.$COMMA) {
+              flush();
+            }
+            return;
+
+          case common.types.close:
+            flush();
+            return;
+
+          case common.types.keyword:
+            if (special === common.lit.FROM) {
+              flush();
+            }
+            return;
+
+          case common.types.lit:
+            // "foo" of "foo as bar", or a name being reexported
+            if (special & common.specials.external) {
+              if (pending === null || kind !== 'reexport') {
+                pending = token.string();
+              } else {
+                names.push({imported: pending, local: token.string()});
+                pending = null;
+              }
+            }
+            return;
+
+          case common.types.symbol:
+            if (special & common.specials.declare) {
+              const local = token.string();
+              const imported = pending ?? (special & common.specials.external ? local : 'default');
+              names.push({imported, local});
+              pending = null;
+            }
+            return;
+
+          case common.types.string:
+            if (!(special & common.specials.external)) {
+              return;
+            }
+            break;
+
+          default:
+            return;
+        }
+
+        flush();
+        out.push({
+          specifier: token.stringValue(),
+          kind,
+          names,
+          at: token.at(),
+          length: token.length(),
+          line: token.lineNo(),
+        });
+      },
+    });
+
+    harness.scan();
+    return {imports: out, exports: summary?.summary.exports};
+  };
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+export interface ImportMap {
+  imports: {[specifier: string]: string};
+  scopes: {[scope: string]: {[specifier: string]: string}};
+}
+
+/**
+ * Builds an import mapper for files under a root, which is served at "/". Maps are only
+ * regenerated when the root's package.json or a lockfile changes, or after `invalidate`.
+ */
+export default function buildImportMapper(
+  buildResolver: (importer: string) => ((importee: string) => string | undefined | Promise<string | undefined>),
+  options?: {root?: string, concurrency?: number},
+): {
+  importmap(...entries: string[]): Promise<ImportMap>;
+  invalidate(): void;
+};
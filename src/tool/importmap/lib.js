@@ -0,0 +1,176 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Generates an import map for entrypoints from their module graph, so that files
+ * can be served without rewriting their imports.
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+import buildModuleGraph, {isRelative} from '../graph/lib.js';
+
+/**
+ * Files in the root which, if changed, mean that dependencies may resolve differently.
+ */
+const MANIFESTS = ['package.json', 'package-lock.json', 'yarn.lock', 'pnpm-lock.yaml'];
+
+/**
+ * @typedef {{
+ *   imports: {[specifier: string]: string},
+ *   scopes: {[scope: string]: {[specifier: string]: string}},
+ * }} ImportMap
+ */
+
+/**
+ * @param {string} specifier
+ * @return {boolean}
+ */
+function isBare(specifier) {
+  // nb. this excludes URLs and things like "node:fs"
+  return !isRelative(specifier) && !/^[a-z][a-z0-9+.-]*:/i.test(specifier);
+}
+
+/**
+ * Builds an import mapper for files under a root, which is served at "/".
+ *
+ * Bare specifiers are mapped in the top-level "imports" for files of the root package, and in
+ * "scopes" for files inside other packages (e.g., within "node_modules"). Relative specifiers
+ * which resolve elsewhere (e.g., missing their ".js") are also mapped.
+ *
+ * The map is only regenerated when the root's package.json or a lockfile changes, or after an
+ * explicit call to `invalidate`. Call that if your own source starts importing new packages.
+ *
+ * @param {(importer: string) => (importee: string) => string|undefined|Promise<string|undefined>} buildResolver
+ * @param {{root?: string, concurrency?: number}=} options
+ */
+export default function buildImportMapper(buildResolver, {root = '.', concurrency} = {}) {
+  root = path.resolve(root);
+
+  /** @type {Map<string, {map: ImportMap, stamp: string}>} */
+  const cache = new Map();
+
+  /** @type {Map<string, string>} */
+  const packageRoots = new Map();
+
+  /**
+   * @return {string}
+   */
+  const manifestStamp = () => {
+    return MANIFESTS.map((name) => {
+      try {
+        const stat = fs.statSync(path.join(root, name));
+        return `${stat.mtimeMs}:${stat.size}`;
+      } catch (e) {
+        return '';
+      }
+    }).join(',');
+  };
+
+  /**
+   * Finds the closest directory containing a package.json, stopping at the root.
+   *
+   * @param {string} dir
+   * @return {string}
+   */
+  const packageRoot = (dir) => {
+    let out = packageRoots.get(dir);
+    if (out === undefined) {
+      if (dir === root || !dir.startsWith(root + path.sep)) {
+        out = root;
+      } else if (fs.existsSync(path.join(dir, 'package.json'))) {
+        out = dir;
+      } else {
+        out = packageRoot(path.dirname(dir));
+      }
+      packageRoots.set(dir, out);
+    }
+    return out;
+  };
+
+  /**
+   * @param {string} f
+   * @return {string}
+   */
+  const toURL = (f) => '/' + path.relative(root, f).split(path.sep).join('/');
+
+  /**
+   * @param {string[]} entries
+   * @return {Promise<ImportMap>}
+   */
+  const generate = async (entries) => {
+    const {graph, add} = await buildModuleGraph(buildResolver, {concurrency});
+    await add(...entries);
+
+    /** @type {ImportMap} */
+    const map = {imports: {}, scopes: {}};
+
+    for (const [f, {edges}] of graph) {
+      const pkg = packageRoot(path.dirname(f));
+      const scope = pkg === root ? '' : toURL(pkg) + '/';
+
+      for (const {specifier, resolved} of edges) {
+        if (!resolved) {
+          continue;
+        }
+        const url = toURL(resolved);
+
+        if (isBare(specifier)) {
+          const target = scope ? (map.scopes[scope] ??= {}) : map.imports;
+          target[specifier] = url;
+          continue;
+        }
+
+        // relative imports are mapped by their full URL, but only if they go somewhere else
+        const naive = toURL(path.resolve(path.dirname(f), specifier));
+        if (naive !== url) {
+          map.imports[naive] = url;
+        }
+      }
+    }
+
+    return map;
+  };
+
+  return {
+
+    /**
+     * Returns the import map for the passed entrypoints, regenerating it only if stale.
+     *
+     * @param {...string} entries
+     * @return {Promise<ImportMap>}
+     */
+    async importmap(...entries) {
+      entries = entries.map((f) => path.resolve(root, f));
+      const key = entries.join('\0');
+      const stamp = manifestStamp();
+
+      const prev = cache.get(key);
+      if (prev?.stamp === stamp) {
+        return prev.map;
+      }
+
+      const map = await generate(entries);
+      cache.set(key, {map, stamp});
+      return map;
+    },
+
+    invalidate() {
+      cache.clear();
+      packageRoots.clear();
+    },
+  };
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Caches the output of an imports rewriter, keyed on the content of each file plus
+ * the state of its resolver. Files are first validated via their mtime/size, so unchanged files
+ * are not even read.
+ *
+ * Entries may also be written to a directory, which is kept under `dirMaxBytes` by occasionally
+ * evicting the least recently used. Hits touch the entry's mtime (at most hourly).
+ */
+
+import * as fs from 'fs';
+import * as path from 'path';
+import * as crypto from 'crypto';
+import {threadId} from 'worker_threads';
+
+const DEFAULT_MAX = 256;
+const DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+const DEFAULT_DIR_MAX_BYTES = 256 * 1024 * 1024;
+const TOUCH_AFTER_MS = 60 * 60 * 1000;
+const STALE_TEMP_MS = 60 * 60 * 1000;
+const DEFAULT_MANIFEST_TTL_MS = 1000;
+
+/**
+ * Files which, if changed in any parent of an importer, mean that its imports may resolve
+ * differently.
+ */
+const MANIFESTS = ['package.json', 'package-lock.json', 'yarn.lock', 'pnpm-lock.yaml'];
+
+/**
+ * @param {string|Uint8Array} data
+ * @return {string}
+ */
+function hash(data) {
+  return crypto.createHash('sha256').update(data).digest('hex');
+}
+
+/**
+ * Builds the default resolver state: the absolute path of the importer, as the rewritten imports
+ * are relative to it, plus the mtime/size of every manifest in its parent directories.
+ *
+ * Each directory's manifests are only checked again after `ttlMs`, so a hit usually costs no
+ * syscalls, but a manifest change may take that long to be seen.
+ *
+ * @param {number=} ttlMs
+ * @return {(file: string) => string}
+ */
+export function buildResolverKey(ttlMs = DEFAULT_MANIFEST_TTL_MS) {
+  /** @type {Map<string, {stamp: string, checkedAt: number}>} */
+  const stamps = new Map();
+
+  /**
+   * @param {string} dir
+   * @param {number} now
+   * @return {string} the manifests of this directory and its parents
+   */
+  const stampFor = (dir, now) => {
+    const prev = stamps.get(dir);
+    if (prev && now - prev.checkedAt < ttlMs) {
+      return prev.stamp;
+    }
+
+    /** @type {string[]} */
+    const parts = [];
+    for (const name of MANIFESTS) {
+      const stat = fs.statSync(path.join(dir, name), {throwIfNoEntry: false});
+      if (stat) {
+        parts.push(`${dir}${path.sep}${name}:${stat.mtimeMs}:${stat.size}`);
+      }
+    }
+    const parent = path.dirname(dir);
+    if (parent !== dir) {
+      parts.push(stampFor(parent, now));
+    }
+
+    const stamp = parts.join('\0');
+    stamps.set(dir, {stamp, checkedAt: now});
+    return stamp;
+  };
+
+  return (file) => {
+    file = path.resolve(file);
+    return `${file}\0${stampFor(path.dirname(file), Date.now())}`;
+  };
+}
+
+/**
+ * Wraps a rewriter as returned by `buildModuleImportRewriter`. The returned `run` has the same
+ * signature, but writes cached output in a single part.
+ *
+ * By default, the resolver state is the absolute path of the importer plus its manifests (see
+ * `buildResolverKey`, which checks them at most every `manifestTtlMs`), so installing or changing
+ * packages is a miss. Pass `resolverKey` to include other state (e.g., the resolver's own options).
+ *
+ * @param {(file: string, write: (part: Uint8Array) => void) => void} rewrite
+ * @param {{
+ *   max?: number,
+ *   maxBytes?: number,
+ *   dir?: string,
+ *   dirMaxBytes?: number,
+ *   manifestTtlMs?: number,
+ *   resolverKey?: (file: string) => string,
+ * }=} options
+ */
+export default function buildRewriteCache(rewrite, {
+  max = DEFAULT_MAX,
+  maxBytes = DEFAULT_MAX_BYTES,
+  dir = '',
+  dirMaxBytes = DEFAULT_DIR_MAX_BYTES,
+  manifestTtlMs = DEFAULT_MANIFEST_TTL_MS,
+  resolverKey = buildResolverKey(manifestTtlMs),
+} = {}) {
+  /** @type {Map<string, Uint8Array>} */
+  const entries = new Map();
+  let bytes = 0;
+
+  /** @type {Map<string, {mtimeMs: number, size: number, contentHash: string}>} */
+  const known = new Map();
+
+  const stats = {hits: 0, misses: 0, diskHits: 0, unread: 0, evicted: 0};
+
+  // bytes written to the directory since it was last checked, which starts off as "too many"
+  let written = Infinity;
+
+  if (dir) {
+    fs.mkdirSync(dir, {recursive: true});
+  }
+
+  /**
+   * @param {string} key
+   * @param {Uint8Array} out
+   */
+  const store = (key, out) => {
+    entries.set(key, out);
+    bytes += out.length;
+
+    // Map iterates in insertion order, so the first entries are the least recently used.
+    for (const [key, prev] of entries) {
+      if (entries.size <= max && bytes <= maxBytes) {
+        break;
+      }
+      entries.delete(key);
+      bytes -= prev.length;
+    }
+  };
+
+  /**
+   * @param {string} key
+   * @return {Uint8Array|undefined}
+   */
+  const lookup = (key) => {
+    const out = entries.get(key);
+    if (out !== undefined) {
+      // bump to most recently used
+      entries.delete(key);
+      entries.set(key, out);
+      return out;
+    }
+    if (!dir) {
+      return;
+    }
+
+    let fd;
+    try {
+      fd = fs.openSync(path.join(dir, key), 'r');
+    } catch (e) {
+      return;
+    }
+    let disk;
+    try {
+      disk = fs.readFileSync(fd);
+      if (Date.now() - fs.fstatSync(fd).mtimeMs > TOUCH_AFTER_MS) {
+        const now = new Date();
+        fs.futimesSync(fd, now, now);
+      }
+    } catch (e) {
+      return;
+    } finally {
+      fs.closeSync(fd);
+    }
+    ++stats.diskHits;
+    store(key, disk);
+    return disk;
+  };
+
+  /**
+   * @param {string} key
+   * @param {Uint8Array} out
+   */
+  const persist = (key, out) => {
+    // write then rename, so concurrent readers never see a partial file
+    const target = path.join(dir, key);
+    const temp = `${target}.${process.pid}.${threadId}.tmp`;
+    try {
+      fs.writeFileSync(temp, out);
+      fs.renameSync(temp, target);
+    } catch (e) {
+      try {
+        fs.unlinkSync(temp);
+      } catch (e) {
+        // ignore
+      }
+      return;
+    }
+
+    written += out.length;
+    if (written > dirMaxBytes / 8) {
+      evict();
+    }
+  };
+
+  /**
+   * Removes the least recently used entries (and abandoned temporary files) until the directory
+   * is under three quarters of `dirMaxBytes`. Entries may be removed concurrently by other
+   * processes.
+   */
+  const evict = () => {
+    written = 0;
+
+    /** @type {{file: string, size: number, mtimeMs: number}[]} */
+    const all = [];
+    let total = 0;
+    const now = Date.now();
+
+    for (const name of fs.readdirSync(dir)) {
+      const file = path.join(dir, name);
+      try {
+        const {size, mtimeMs} = fs.statSync(file);
+        if (name.endsWith('.tmp')) {
+          if (now - mtimeMs > STALE_TEMP_MS) {
+            fs.unlinkSync(file);
+          }
+          continue;
+        }
+        all.push({file, size, mtimeMs});
+        total += size;
+      } catch (e) {
+        // removed by another process
+      }
+    }
+
+    if (total <= dirMaxBytes) {
+      return;
+    }
+    all.sort((a, b) => a.mtimeMs - b.mtimeMs);
+    for (const {file, size} of all) {
+      if (total <= dirMaxBytes * 0.75) {
+        break;
+      }
+      try {
+        fs.unlinkSync(file);
+        ++stats.evicted;
+      } catch (e) {
+        // removed by another process
+      }
+      total -= size;
+    }
+  };
+
+  /**
+   * @param {string} f
+   * @param {(part: Uint8Array) => void} write
+   */
+  const run = (f, write) => {
+    const stat = fs.statSync(f);
+    const prev = known.get(f);
+
+    /** @type {Uint8Array|undefined} */
+    let out;
+    let key = '';
+
+    if (prev && prev.mtimeMs === stat.mtimeMs && prev.size === stat.size) {
+      key = hash(prev.contentHash + '\0' + resolverKey(f));
+      out = lookup(key);
+      if (out !== undefined) {
+        ++stats.unread;
+      }
+    }
+
+    if (out === undefined) {
+      const contentHash = hash(fs.readFileSync(f));
+      known.set(f, {mtimeMs: stat.mtimeMs, size: stat.size, contentHash});
+      key = hash(contentHash + '\0' + resolverKey(f));
+      out = lookup(key);
+    }
+
+    if (out !== undefined) {
+      ++stats.hits;
+      write(out);
+      return;
+    }
+    ++stats.misses;
+
+    /** @type {Uint8Array[]} */
+    const parts = [];
+    rewrite(f, (part) => {
+      parts.push(part);
+      write(part);
+    });
+    out = Buffer.concat(parts);  // copies parts, which may be views into the harness memory
+    store(key, out);
+
+    if (dir) {
+      persist(key, out);
+    }
+  };
+
+  return {
+    run,
+
+    stats() {
+      const total = stats.hits + stats.misses;
+      return {
+        ...stats,
+        entries: entries.size,
+        bytes,
+        hitRate: total ? stats.hits / total : 0,
+      };
+    },
+
+    clear() {
+      entries.clear();
+      known.clear();
+      bytes = 0;
+    },
+  };
+}
@@ -23,3 +23,52 @@
 export default function buildModuleImportRewriter(
   buildResolver: (importer: string) => ((importee: string) => string|undefined),
 ): Promise<(file: string, write: (part: Uint8Array) => void) => void>;
+
+export interface RewriteCacheOptions {
+  /** Maximum number of outputs kept in memory. */
+  max: number;
+  /** Maximum number of bytes kept in memory. */
+  maxBytes: number;
+  /** Optional directory to also store outputs in, shared between runs. */
+  dir: string;
+  /** Maximum number of bytes kept in `dir`, evicting the least recently used. */
+  dirMaxBytes: number;
+  /** How long the default resolver state trusts a directory's manifests before checking again. */
+  manifestTtlMs: number;
+  /** Returns the state of the resolver for a file. Defaults to {@link buildResolverKey}. */
+  resolverKey: (file: string) => string;
+}
+
+export interface RewriteCacheStats {
+  hits: number;
+  misses: number;
+  /** Hits which were loaded from the on-disk store. */
+  diskHits: number;
+  /** Hits which were validated only by mtime/size, so the file was not read. */
+  unread: number;
+  /** Entries removed from `dir` to keep it under `dirMaxBytes`. */
+  evicted: number;
+  entries: number;
+  bytes: number;
+  hitRate: number;
+}
+
+/**
+ * Builds a function which returns the absolute path of a file plus the mtime/size of the
+ * package.json and lockfiles in its parent directories, checking each directory at most every
+ * `ttlMs` (default 1000).
+ */
+export function buildResolverKey(ttlMs?: number): (file: string) => string;
+
+/**
+ * Wraps a rewriter built by {@link buildModuleImportRewriter} with a cache keyed on file content
+ * plus resolver state.
+ */
+export function buildRewriteCache(
+  rewrite: (file: string, write: (part: Uint8Array) => void) => void,
+  options?: Partial<RewriteCacheOptions>,
+): {
+  run: (file: string, write: (part: Uint8Array) => void) => void;
+  stats: () => RewriteCacheStats;
+  clear: () => void;
+};
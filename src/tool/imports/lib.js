@@ -18,6 +18,8 @@ import * as common from '../../harness/common.js';
 import buildHarness from '../../harness/node-harness.js';
 import rewriter from '../../harness/node-rewriter.js';
 
+export {default as buildRewriteCache, buildResolverKey} from './cache.js';
+
 // Set to true to allow all stacks to be parsed (even though we don't need to as modules are
 // top-level). Useful for debugging.
 const allowAllStack = false;
@@ -42,7 +44,8 @@ export default async function buildModuleImportRewriter(buildResolver) {
   return (f, write) => {
     const resolver = buildResolver(f);
     const callback = () => {
-      if (!(token.special() === common.specials.external && token.type() === common.types.string)) {
+      // nb. this includes dynamic imports, which also have specials.dynamic
+      if (!(token.special() & common.specials.external && token.type() === common.types.string)) {
         return;
       }
       const out = resolver(token.stringValue());
@@ -50,6 +53,6 @@ export default async function buildModuleImportRewriter(buildResolver) {
         return JSON.stringify(out);
       }
     };
-    return run(f, {callback, stack, write});
+    return run(f, {callback, stack, write, scan: true});
   };
 }
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Measures the throughput of the light minifier over passed files.
+ *
+ * Usage: node src/tool/minify/bench.js [--runs=N] <file...>
+ */
+
+import * as fs from 'fs';
+import buildMinifier from './lib.js';
+
+const args = process.argv.slice(2);
+let runs = 10;
+const files = args.filter((arg) => {
+  const m = /^--runs=(\d+)$/.exec(arg);
+  if (m) {
+    runs = +m[1];
+    return false;
+  }
+  return true;
+});
+if (!files.length) {
+  console.error('usage: bench.js [--runs=N] <file...>');
+  process.exit(1);
+}
+
+const minify = await buildMinifier();
+const inputBytes = files.reduce((total, f) => total + fs.statSync(f).size, 0);
+
+let outputBytes = 0;
+const write = (/** @type {Uint8Array} */ part) => {
+  outputBytes += part.length;
+};
+
+// warm up, and check every file parses
+for (const f of files) {
+  minify(f, write);
+}
+const ratio = outputBytes / inputBytes;
+
+const start = process.hrtime.bigint();
+for (let i = 0; i < runs; ++i) {
+  for (const f of files) {
+    minify(f, write);
+  }
+}
+const seconds = Number(process.hrtime.bigint() - start) / 1e9;
+const mb = (inputBytes * runs) / (1024 * 1024);
+
+console.info(`files=${files.length} input=${inputBytes}b output=${(ratio * 100).toFixed(1)}%`);
+console.info(`runs=${runs} time=${seconds.toFixed(3)}s throughput=${(mb / seconds).toFixed(2)}MB/s`);
@@ -0,0 +1,22 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * Builds a method which strips whitespace and comments from a passed file, keeping only the
+ * newlines or spaces needed to retain its meaning. Has the same signature as the imports
+ * rewriter, so it can be wrapped by its cache.
+ */
+export default function buildMinifier(): Promise<(file: string, write: (part: Uint8Array) => void) => void>;
@@ -0,0 +1,187 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Provides a "light minifier" which strips whitespace and comments between tokens,
+ * inserting only the single separator that each removed region needs.
+ */
+
+import * as fs from 'fs';
+import * as common from '../../harness/common.js';
+import buildHarness from '../../harness/node-harness.js';
+
+const NEWLINE = 10;
+const SPACE = 32;
+
+/**
+ * @param {number} c
+ * @return {boolean} whether this byte can be part of an identifier, keyword or number
+ */
+const isWord = (c) => (c >= 97 && c <= 122) || (c >= 65 && c <= 90) || (c >= 48 && c <= 57) ||
+    c === 36 || c === 95 || c === 92 || c >= 128;
+
+/**
+ * @param {number} prev last byte of the previous token
+ * @param {number} next first byte of the next token
+ * @return {boolean} whether these bytes would join into a different token if adjacent
+ */
+const needsSpace = (prev, next) => {
+  if (isWord(prev)) {
+    return isWord(next);
+  }
+  switch (prev) {
+    case 43:  // +
+    case 45:  // -
+      return next === prev;
+    case 47:  // /, which would start a comment
+      return next === 47 || next === 42;
+    case 60:  // <, which would start "<!--"
+      return next === 33;
+  }
+  return false;
+};
+
+/**
+ * @param {Uint8Array} view
+ * @param {number} from
+ * @param {number} to
+ * @return {boolean} whether this range contains a line terminator
+ */
+function hasNewline(view, from, to) {
+  for (let i = from; i < to; ++i) {
+    switch (view[i]) {
+      case 10:
+      case 13:
+        return true;
+      case 0xe2:
+        // U+2028 and U+2029 are also line terminators
+        if (view[i + 1] === 0x80 && (view[i + 2] === 0xa8 || view[i + 2] === 0xa9)) {
+          return true;
+        }
+    }
+  }
+  return false;
+}
+
+/**
+ * Builds a method which strips whitespace and comments from a passed file.
+ *
+ * Newlines are kept where automatic semicolon insertion might depend on them, unless the previous
+ * or next token makes it clear that it cannot. A leading "#!" line is retained.
+ *
+ * @return {Promise<(file: string, write: (part: Uint8Array) => void) => void>}
+ */
+export default async function buildMinifier() {
+  const harness = await buildHarness();
+  const {token} = harness;
+
+  return (f, write) => {
+    const size = fs.statSync(f).size;
+    const buffer = harness.prepare(size);
+    const fd = fs.openSync(f, 'r');
+    try {
+      const read = fs.readSync(fd, buffer, 0, size, 0);
+      if (read !== size) {
+        throw new Error(`did not read all bytes at once: ${read}/${size}`);
+      }
+    } finally {
+      fs.closeSync(fd);
+    }
+
+    // The output is never longer than the input, as separators only replace non-empty voids.
+    const out = new Uint8Array(size);
+    let length = 0;
+
+    let prevEnd = 0;
+    let prevType = 0;
+    let prevSpecial = 0;
+
+    if (buffer[0] === 35 && buffer[1] === 33) {
+      // retain "#!" line including its newline, which acts as the separator
+      prevEnd = buffer.indexOf(NEWLINE) + 1 || size;
+      out.set(buffer.subarray(0, prevEnd));
+      length = prevEnd;
+      prevType = common.types.semicolon;
+    }
+
+    harness.handle({
+      callback() {
+        const len = token.length();
+        if (!len) {
+          return;  // ASI semicolon, the void around it decides whether a newline is kept
+        }
+        const at = token.at();
+        const type = token.type();
+
+        if (at !== prevEnd && length) {
+          if (hasNewline(buffer, prevEnd, at) && !canJoinLines(prevType, prevSpecial, type, token.special())) {
+            out[length++] = NEWLINE;
+          } else if (needsSpace(buffer[prevEnd - 1], buffer[at]) ||
+              (prevType === common.types.number && buffer[at] === 46)) {
+            // nb. "1 .toString()" is different to "1.toString()"
+            out[length++] = SPACE;
+          }
+        }
+
+        out.set(buffer.subarray(at, at + len), length);
+        length += len;
+
+        prevEnd = at + len;
+        prevType = type;
+        prevSpecial = token.special();
+      },
+    });
+    harness.run();
+
+    write(out.subarray(0, length));
+  };
+}
+
+/**
+ * @param {number} prevType
+ * @param {number} prevSpecial
+ * @param {number} nextType
+ * @param {number} nextSpecial
+ * @return {boolean} whether a newline between these tokens is never needed for ASI
+ */
+function canJoinLines(prevType, prevSpecial, nextType, nextSpecial) {
+  switch (prevType) {
+    case common.types.semicolon:
+    case common.types.colon:
+    case common.types.brace:
+    case common.types.array:
+    case common.types.paren:
+    case common.types.ternary:
+    case common.types.block:
+      return true;
+
+    case common.types.op:
+      // "a++\nb" is not "a++b", and "yield\nb" yields undefined
+      return prevSpecial !== common.lit.$INCDEC && prevSpecial !== common.lit.YIELD;
+  }
+
+  switch (nextType) {
+    case common.types.semicolon:
+    case common.types.close:
+      return true;
+
+    case common.types.op:
+      // only commas are safe, other ops might be unary or start a new statement
+      return nextSpecial === common.lit.$COMMA;
+  }
+
+  return false;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import {ModuleNode} from '../graph/lib';
+
+export interface ImportBinding {
+  local: string;
+
+  /** The name in the other module, "default" or "*" for namespaces. */
+  imported: string;
+  specifier: string;
+  at: number;
+  line: number;
+
+  /** References within the module, excluding property positions. Zero if unused. */
+  references: number;
+}
+
+export interface UnusedReexport {
+  file: string;
+  name: string;
+  specifier: string;
+  at: number;
+  line: number;
+}
+
+/**
+ * Builds a counter of references to each imported binding in passed source. This doesn't track
+ * scope, so it may miss unused imports but won't report used ones.
+ */
+export default function buildImportUsage(): Promise<(source: Uint8Array) => ImportBinding[]>;
+
+/**
+ * Finds named reexports in a module graph which are never imported by another module.
+ */
+export function findUnusedReexports(
+  graph: Map<string, ModuleNode>,
+  entries: Iterable<string>,
+): UnusedReexport[];
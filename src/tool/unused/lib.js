@@ -0,0 +1,206 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Finds imported bindings which are never referenced within a module, and reexports
+ * which are never imported by anything else in a module graph.
+ */
+
+import * as common from '../../harness/common.js';
+import buildHarness from '../../harness/node-harness.js';
+
+/**
+ * @typedef {{
+ *   local: string,
+ *   imported: string,
+ *   specifier: string,
+ *   at: number,
+ *   line: number,
+ *   references: number,
+ * }} ImportBinding
+ *
+ * @typedef {{
+ *   file: string,
+ *   name: string,
+ *   specifier: string,
+ *   at: number,
+ *   line: number,
+ * }} UnusedReexport
+ */
+
+/**
+ * Builds a counter of references to each imported binding in passed source. Bindings with zero
+ * references are unused.
+ *
+ * This doesn't track scope: a reference to a shadowing variable of the same name counts, so this
+ * may miss unused imports but won't report used ones.
+ *
+ * @return {Promise<(source: Uint8Array) => ImportBinding[]>}
+ */
+export default async function buildImportUsage() {
+  const harness = await buildHarness();
+  const {token} = harness;
+
+  return (source) => {
+    const memory = harness.prepare(source.length);
+    memory.set(source);
+
+    /** @type {ImportBinding[]} */
+    const bindings = [];
+
+    /** @type {Map<string, number>} */
+    const references = new Map();
+
+    // tokens in import statements are collected as they don't announce the specifier until last
+    let inImport = false;
+    let index = 0;
+    let depth = 0;
+
+    /** @type {{local: string, imported: string, at: number, line: number}[]} */
+    let pending = [];
+    /** @type {string?} */
+    let imported = null;
+
+    harness.handle({
+      open(type) {
+        ++depth;
+        if (type === common.stacks.module && depth === 1) {
+          index = 0;
+          pending = [];
+          imported = null;
+        }
+      },
+
+      close() {
+        --depth;
+        inImport = false;
+      },
+
+      callback() {
+        const type = token.type();
+        const special = token.special();
+
+        if (depth === 1 && index === 0) {
+          ++index;
+          inImport = (special === common.lit.IMPORT);
+          return;
+        }
+        ++index;
+
+        if (!inImport) {
+          // property names are lits, so symbols are the only references
+          if (type === common.types.symbol && !(special & common.specials.declare)) {
+            const name = token.string();
+            references.set(name, (references.get(name) ?? 0) + 1);
+          }
+          return;
+        }
+
+        switch (type) {
+          case common.types.paren:
+            inImport = false;  // this is actually `import(...)`
+            return;
+
+          case common.types.op:
+            if (special === common.lit.$STAR) {
+              imported = '*';
+            }
+            return;
+
+          case common.types.lit:
+            if (special & common.specials.external) {
+              imported = token.string();
+            }
+            return;
+
+          case common.types.symbol: {
+            const local = token.string();
+            pending.push({
+              local,
+              imported: imported ?? (special & common.specials.external ? local : 'default'),
+              at: token.at(),
+              line: token.lineNo(),
+            });
+            imported = null;
+            return;
+          }
+
+          case common.types.string:
+            if (special & common.specials.external) {
+              const specifier = token.stringValue();
+              bindings.push(...pending.map((p) => ({...p, specifier, references: 0})));
+              pending = [];
+            }
+        }
+      },
+    });
+
+    harness.run();
+
+    for (const binding of bindings) {
+      binding.references = references.get(binding.local) ?? 0;
+    }
+    return bindings;
+  };
+}
+
+/**
+ * Finds named reexports in a module graph which are never imported by another module. Entrypoints
+ * are assumed to be used externally, so their reexports are always consumed. Namespace imports,
+ * dynamic imports and `export *` consume every name.
+ *
+ * @param {Map<string, import('../graph/lib.js').ModuleNode>} graph
+ * @param {Iterable<string>} entries
+ * @return {UnusedReexport[]}
+ */
+export function findUnusedReexports(graph, entries) {
+  const entrySet = new Set(entries);
+
+  /** @type {UnusedReexport[]} */
+  const out = [];
+
+  for (const [file, node] of graph) {
+    if (entrySet.has(file)) {
+      continue;
+    }
+
+    /** @type {Set<string>} */
+    const consumed = new Set();
+    for (const importer of node.importers) {
+      for (const edge of graph.get(importer)?.edges ?? []) {
+        if (edge.resolved === file) {
+          edge.names.forEach(({imported}) => consumed.add(imported));
+        }
+      }
+    }
+    if (consumed.has('*')) {
+      continue;
+    }
+
+    for (const edge of node.edges) {
+      if (edge.kind !== 'reexport') {
+        continue;
+      }
+      for (const {local} of edge.names) {
+        if (local !== '*' && !consumed.has(local)) {
+          out.push({file, name: local, specifier: edge.specifier, at: edge.at, line: edge.line});
+        }
+      }
+    }
+  }
+
+  return out;
+}
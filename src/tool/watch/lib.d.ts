@@ -0,0 +1,54 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+import {GraphDelta, ModuleEdge, ModuleNode} from '../graph/lib';
+
+export interface WatchedModule {
+  imports: {specifier: string, kind: ModuleEdge['kind'], resolved: string | null}[];
+
+  /** Exported names, including "default", and "*" for `export * from`. */
+  exports: string[];
+
+  /** Set if this file could not be read or parsed. */
+  error?: string;
+}
+
+export interface WatchDelta extends GraphDelta {
+  /** Description of every added or changed file. */
+  modules: {[file: string]: WatchedModule};
+}
+
+/**
+ * Builds a watcher over the module graph reachable from entrypoints passed to `add`. Changed files
+ * are re-parsed and announced to subscribers, including newline-delimited JSON over `socket`.
+ */
+export default function buildWatcher(
+  buildResolver: (importer: string) => ((importee: string) => string | undefined | Promise<string | undefined>),
+  options?: {
+    rewrite?: (file: string, write: (part: Uint8Array) => void) => void,
+    socket?: string,
+    debounce?: number,
+    concurrency?: number,
+  },
+): Promise<{
+  graph: Map<string, ModuleNode>;
+  add(...files: string[]): Promise<GraphDelta>;
+  subscribe(fn: (delta: WatchDelta) => void): () => void;
+  module(file: string): WatchedModule | undefined;
+  output(file: string): Uint8Array | undefined;
+  settled(): Promise<void>;
+  close(): void;
+}>;
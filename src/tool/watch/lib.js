@@ -0,0 +1,290 @@
+/*
+ * Copyright 2021 Sam Thorogood.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+/**
+ * @fileoverview Long-lived watcher over a module graph. Keeps the imports, exports and (lazily)
+ * rewritten output of every reachable file, re-parses only files which change, and pushes graph
+ * deltas to subscribers, including over a local socket as newline-delimited JSON.
+ *
+ * Directories are watched with `fs.watch`, which uses inotify on Linux. Watching directories rather
+ * than files means editors which save by renaming a new file into place are still seen.
+ */
+
+import * as fs from 'fs';
+import * as net from 'net';
+import * as path from 'path';
+import {noop} from '../../harness/harness.js';
+import buildModuleGraph from '../graph/lib.js';
+
+const DEFAULT_DEBOUNCE = 20;
+
+/**
+ * @typedef {import('../graph/lib.js').ModuleEdge} ModuleEdge
+ * @typedef {import('../graph/lib.js').GraphDelta} GraphDelta
+ *
+ * @typedef {{
+ *   imports: {specifier: string, kind: ModuleEdge['kind'], resolved: string?}[],
+ *   exports: string[],
+ *   error?: string,
+ * }} WatchedModule
+ *
+ * @typedef {GraphDelta & {modules: {[file: string]: WatchedModule}}} WatchDelta
+ */
+
+/**
+ * Builds a watcher over the module graph reachable from entrypoints passed to `add`. The resolver
+ * is as for `buildModuleGraph`. Pass `rewrite` (e.g., from `buildModuleImportRewriter`) to serve
+ * rewritten output via `output`, and `socket` to listen for subscribers on a unix socket path.
+ *
+ * Each socket subscriber is first sent a delta adding every known file, then each later delta.
+ *
+ * @param {(importer: string) => (importee: string) => string|undefined|Promise<string|undefined>} buildResolver
+ * @param {{
+ *   rewrite?: (file: string, write: (part: Uint8Array) => void) => void,
+ *   socket?: string,
+ *   debounce?: number,
+ *   concurrency?: number,
+ * }=} options
+ */
+export default async function buildWatcher(buildResolver, {
+  rewrite,
+  socket,
+  debounce = DEFAULT_DEBOUNCE,
+  concurrency,
+} = {}) {
+  const moduleGraph = await buildModuleGraph(buildResolver, {concurrency, exports: true});
+  const {graph} = moduleGraph;
+
+  /** @type {Map<string, {output?: Uint8Array}>} */
+  const state = new Map();
+
+  /** @type {Map<string, fs.FSWatcher>} */
+  const watchers = new Map();
+
+  /** @type {Set<(delta: WatchDelta) => void>} */
+  const subscribers = new Set();
+
+  /** @type {Set<string>} */
+  const pending = new Set();
+  let timeout = /** @type {NodeJS.Timeout?} */ (null);
+  let queue = Promise.resolve();
+
+  /**
+   * @param {string} f
+   * @return {WatchedModule}
+   */
+  const describe = (f) => {
+    const node = graph.get(f);
+    /** @type {WatchedModule} */
+    const out = {
+      imports: (node?.edges ?? []).map(({specifier, kind, resolved}) => ({specifier, kind, resolved})),
+      exports: node?.exports ?? [],
+    };
+    if (node?.error) {
+      out.error = node.error.message;
+    }
+    return out;
+  };
+
+  /**
+   * Updates per-file state after a graph change, watches any new directories, and announces it.
+   *
+   * @param {GraphDelta} delta
+   */
+  const apply = (delta) => {
+    for (const f of delta.removed) {
+      state.delete(f);
+    }
+
+    /** @type {WatchDelta} */
+    const out = {...delta, modules: {}};
+    for (const f of [...delta.added, ...delta.changed]) {
+      state.set(f, {});  // drops any stale output
+      out.modules[f] = describe(f);
+    }
+
+    syncWatchers();
+    if (delta.added.length || delta.removed.length || delta.changed.length) {
+      subscribers.forEach((fn) => fn(out));
+    }
+  };
+
+  const syncWatchers = () => {
+    const dirs = new Set([...graph.keys()].map((f) => path.dirname(f)));
+
+    for (const [dir, watcher] of watchers) {
+      if (!dirs.has(dir)) {
+        watcher.close();
+        watchers.delete(dir);
+      }
+    }
+
+    for (const dir of dirs) {
+      if (watchers.has(dir)) {
+        continue;
+      }
+      try {
+        const watcher = fs.watch(dir, {persistent: true}, (_, filename) => {
+          if (filename) {
+            changed(path.join(dir, filename.toString()));
+          }
+        });
+        watcher.on('error', () => {
+          // e.g., the directory was removed, which the graph finds when its files are updated
+          watcher.close();
+          watchers.delete(dir);
+        });
+        watchers.set(dir, watcher);
+      } catch (e) {
+        // directory does not exist (yet)
+      }
+    }
+  };
+
+  /**
+   * @param {string} f
+   */
+  const changed = (f) => {
+    if (!graph.has(f)) {
+      return;
+    }
+    pending.add(f);
+    if (timeout === null) {
+      timeout = setTimeout(flush, debounce);
+    }
+  };
+
+  const flush = () => {
+    timeout = null;
+    const files = [...pending];
+    pending.clear();
+    queue = queue.then(async () => apply(await moduleGraph.update(...files))).catch(noop);
+  };
+
+  /** @type {net.Server?} */
+  let server = null;
+  /** @type {Set<net.Socket>} */
+  const clients = new Set();
+
+  if (socket) {
+    try {
+      fs.unlinkSync(socket);  // stale from a previous run
+    } catch (e) {
+      // ignore
+    }
+
+    server = net.createServer((conn) => {
+      /** @type {WatchDelta} */
+      const initial = {added: [...graph.keys()], removed: [], changed: [], modules: {}};
+      initial.added.forEach((f) => initial.modules[f] = describe(f));
+      conn.write(JSON.stringify(initial) + '\n');
+
+      clients.add(conn);
+      conn.on('close', () => clients.delete(conn));
+      conn.on('error', () => clients.delete(conn));
+    });
+    subscribers.add((delta) => {
+      const line = JSON.stringify(delta) + '\n';
+      clients.forEach((conn) => conn.write(line));
+    });
+
+    const s = server;
+    await new Promise((resolve, reject) => {
+      s.once('error', reject);
+      s.listen(socket, () => resolve(undefined));
+    });
+  }
+
+  return {
+    graph,
+
+    /**
+     * Adds entrypoints, crawling and watching any new modules.
+     *
+     * @param {...string} files
+     * @return {Promise<GraphDelta>}
+     */
+    add(...files) {
+      const p = queue.then(() => moduleGraph.add(...files));
+      queue = p.then(apply).catch(noop);
+      return p;
+    },
+
+    /**
+     * Calls the passed function with every later delta. Returns a function to unsubscribe.
+     *
+     * @param {(delta: WatchDelta) => void} fn
+     * @return {() => void}
+     */
+    subscribe(fn) {
+      subscribers.add(fn);
+      return () => void subscribers.delete(fn);
+    },
+
+    /**
+     * @param {string} f
+     * @return {WatchedModule|undefined}
+     */
+    module(f) {
+      f = path.resolve(f);
+      return graph.has(f) ? describe(f) : undefined;
+    },
+
+    /**
+     * Returns the rewritten output of a file in the graph, which is cached until it changes.
+     *
+     * @param {string} f
+     * @return {Uint8Array|undefined}
+     */
+    output(f) {
+      f = path.resolve(f);
+      const s = state.get(f);
+      if (!rewrite || !s) {
+        return;
+      }
+      if (s.output === undefined) {
+        /** @type {Uint8Array[]} */
+        const parts = [];
+        rewrite(f, (part) => parts.push(Uint8Array.from(part)));  // parts may be views into memory
+        s.output = Buffer.concat(parts);
+      }
+      return s.output;
+    },
+
+    /**
+     * Resolves once all seen changes have been applied.
+     */
+    async settled() {
+      if (timeout !== null) {
+        clearTimeout(timeout);
+        flush();
+      }
+      await queue;
+    },
+
+    close() {
+      if (timeout !== null) {
+        clearTimeout(timeout);
+        timeout = null;
+      }
+      watchers.forEach((watcher) => watcher.close());
+      watchers.clear();
+      clients.forEach((conn) => conn.destroy());
+      server?.close();
+      subscribers.clear();
+    },
+  };
+}